@@ -0,0 +1,186 @@
+#include "batch.h"
+#include "path.h"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+using namespace std;
+
+/**
+ * Convenience struct: batchQuery
+ * ------------------------------
+ * One line of the batch: the two actors being connected and, once a
+ * worker has gotten to it, what the search turned up.  The result path
+ * is only meaningful when found is true.
+ */
+
+struct batchQuery {
+  string source;
+  string target;
+  bool known;
+  bool found;
+  path result;
+  double milliseconds;
+
+  batchQuery(const string& source, const string& target) :
+    source(source), target(target), known(false), found(false), 
+    result(source), milliseconds(0) {}
+};
+
+/**
+ * Convenience struct: batchState
+ * ------------------------------
+ * Everything the workers share.  Workers claim queries one at a time by
+ * bumping nextQuery while holding the lock; the queries themselves are
+ * only ever touched by the worker that claimed them.
+ */
+
+struct batchState {
+  const imdb *db;
+  const searchOptions *options;
+  vector<batchQuery> *queries;
+  int nextQuery;
+  pthread_mutex_t lock;
+};
+
+/**
+ * Returns the number of milliseconds elapsed since the specified start time.
+ */
+
+static double millisecondsSince(const struct timeval& start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+/**
+ * Thread routine: claims and answers queries until there are none left.
+ */
+
+static void *batchWorker(void *data)
+{
+  batchState *state = (batchState *) data;
+  while (true) {
+    pthread_mutex_lock(&state->lock);
+    int index = state->nextQuery++;
+    pthread_mutex_unlock(&state->lock);
+    if (index >= (int) state->queries->size()) return NULL;
+
+    batchQuery& query = (*state->queries)[index];
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    int sourceId = state->db->getActorId(query.source);
+    int targetId = state->db->getActorId(query.target);
+    query.known = sourceId != imdb::kNoSuchId && targetId != imdb::kNoSuchId;
+    if (query.known) {
+      searchStats stats;
+      query.found = sourceId == targetId ? true :
+	findShortestPath(*state->db, sourceId, targetId, *state->options, query.result, stats);
+    }
+    query.milliseconds = millisecondsSince(start);
+  }
+}
+
+/**
+ * Reads the queries, one tab-separated pair per nonblank line.  Lines
+ * without a tab are reported to the stats stream and skipped.
+ */
+
+static void readQueries(istream& in, ostream& stats, vector<batchQuery>& queries)
+{
+  string line;
+  for (int lineNumber = 1; getline(in, line); lineNumber++) {
+    if (line.empty()) continue;
+    size_t tab = line.find('\t');
+    if (tab == string::npos) {
+      stats << "Skipping line " << lineNumber << ", which isn't two tab-separated names." << endl;
+      continue;
+    }
+    queries.push_back(batchQuery(line.substr(0, tab), line.substr(tab + 1)));
+  }
+}
+
+/**
+ * Returns the specified percentile of the sorted latencies.
+ */
+
+static double percentile(const vector<double>& sorted, double fraction)
+{
+  int index = (int) (fraction * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+/**
+ * Writes the wall-clock time for the batch along with the mean and the
+ * percentiles of the per-query latencies.
+ */
+
+static void reportLatencies(const vector<batchQuery>& queries, double wallMilliseconds,
+			    int numThreads, ostream& stats)
+{
+  if (queries.empty()) return;
+  vector<double> latencies;
+  double total = 0;
+  for (int i = 0; i < (int) queries.size(); i++) {
+    latencies.push_back(queries[i].milliseconds);
+    total += queries[i].milliseconds;
+  }
+  sort(latencies.begin(), latencies.end());
+
+  stats << fixed << setprecision(2);
+  stats << (int) queries.size() << " queries on " << numThreads << " threads in " 
+	<< wallMilliseconds << " ms (" << queries.size() * 1000.0 / wallMilliseconds 
+	<< " queries/s)" << endl;
+  stats << "latency (ms): mean " << total / queries.size()
+	<< ", min " << latencies.front()
+	<< ", p50 " << percentile(latencies, 0.50)
+	<< ", p90 " << percentile(latencies, 0.90)
+	<< ", p99 " << percentile(latencies, 0.99)
+	<< ", max " << latencies.back() << endl;
+}
+
+void runBatch(const imdb& db, istream& in, ostream& out, ostream& stats,
+	      int numThreads, const searchOptions& options)
+{
+  vector<batchQuery> queries;
+  readQueries(in, stats, queries);
+  if (numThreads < 1) numThreads = 1;
+  if (numThreads > (int) queries.size()) numThreads = max((int) queries.size(), 1);
+
+  batchState state;
+  state.db = &db;
+  state.options = &options;
+  state.queries = &queries;
+  state.nextQuery = 0;
+  pthread_mutex_init(&state.lock, NULL);
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  vector<pthread_t> workers(numThreads);
+  for (int i = 0; i < numThreads; i++)
+    pthread_create(&workers[i], NULL, batchWorker, &state);
+  for (int i = 0; i < numThreads; i++)
+    pthread_join(workers[i], NULL);
+  double wallMilliseconds = millisecondsSince(start);
+  pthread_mutex_destroy(&state.lock);
+
+  out << fixed << setprecision(3);
+  for (int i = 0; i < (int) queries.size(); i++) {
+    const batchQuery& query = queries[i];
+    int length = query.found ? query.result.getLength() : -1;
+    out << "#" << i + 1 << "\t" << query.source << "\t" << query.target << "\t" 
+	<< length << "\t" << query.milliseconds << " ms" << endl;
+    if (!query.known) {
+      out << "\tAt least one of those people isn't in the movie database." << endl;
+    } else if (!query.found) {
+      out << "\tNo path between those two people could be found." << endl;
+    } else if (length > 0) {
+      out << query.result;
+    }
+  }
+  
+  reportLatencies(queries, wallMilliseconds, numThreads, stats);
+}
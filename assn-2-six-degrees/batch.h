@@ -0,0 +1,32 @@
+#ifndef __batch__
+#define __batch__
+
+#include "imdb.h"
+#include "search.h"
+#include <iostream>
+using namespace std;
+
+/**
+ * Function: runBatch
+ * ------------------
+ * Answers a whole file's worth of shortest-path queries at once.  Each
+ * nonblank line of the input names two actors or actresses separated by a
+ * tab.  The queries are spread across a pool of worker threads, all sharing
+ * the one read-only imdb, and once every query has been answered the
+ * results are written to out in input order, each preceded by a line
+ * giving its position, the two names, the path length (-1 if there's no
+ * path) and how long the search took.  Latency statistics for the batch
+ * as a whole go to stats.
+ *
+ * @param db the imdb to search.
+ * @param in the stream supplying the queries.
+ * @param out the stream the results are written to.
+ * @param stats the stream the latency statistics are written to.
+ * @param numThreads the number of worker threads to run.
+ * @param options selects the search strategy used for every query.
+ */
+
+void runBatch(const imdb& db, istream& in, ostream& out, ostream& stats,
+	      int numThreads, const searchOptions& options);
+
+#endif
@@ -0,0 +1,124 @@
+#include "block-cache.h"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+using namespace std;
+
+blockCache::blockCache(int fd, size_t fileSize, size_t budget, int blockSize) :
+  fd(fd), fileSize(fileSize), blockSize(blockSize), head(-1), tail(-1)
+{
+  int numBlocks = (fileSize + blockSize - 1) / blockSize;
+  int capacity = budget / blockSize;
+  if (capacity < 1) capacity = 1;
+  if (capacity > numBlocks && numBlocks > 0) capacity = numBlocks;
+
+  memory.resize((size_t) capacity * blockSize);
+  blocks.assign(capacity, -1);
+  lengths.assign(capacity, 0);
+  newer.assign(capacity, -1);
+  older.assign(capacity, -1);
+  slotOfBlock.assign(numBlocks, -1);
+  for (int slot = capacity - 1; slot >= 0; slot--) freeSlots.push_back(slot);
+  stats.blockCapacity = capacity;
+  pthread_mutex_init(&lock, NULL);
+}
+
+blockCache::~blockCache()
+{
+  pthread_mutex_destroy(&lock);
+}
+
+void blockCache::unlink(int slot)
+{
+  if (newer[slot] == -1) head = older[slot]; else older[newer[slot]] = older[slot];
+  if (older[slot] == -1) tail = newer[slot]; else newer[older[slot]] = newer[slot];
+  newer[slot] = older[slot] = -1;
+}
+
+void blockCache::pushFront(int slot)
+{
+  newer[slot] = -1;
+  older[slot] = head;
+  if (head != -1) newer[head] = slot;
+  head = slot;
+  if (tail == -1) tail = slot;
+}
+
+/*
+ * Returns the slot holding the specified block, having read it in (into a
+ * free slot, or else into the least recently used one) if it wasn't there,
+ * and marks it the most recently used.  Returns -1 if the block can't be
+ * read.  The lock must be held.
+ */
+int blockCache::acquireBlock(int block)
+{
+  int slot = slotOfBlock[block];
+  if (slot != -1) {
+    stats.hits++;
+    unlink(slot);
+    pushFront(slot);
+    return slot;
+  }
+
+  stats.misses++;
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    slot = tail;
+    unlink(slot);
+    slotOfBlock[blocks[slot]] = -1;
+    stats.evictions++;
+  }
+
+  size_t start = (size_t) block * blockSize;
+  size_t wanted = min((size_t) blockSize, fileSize - start);
+  size_t filled = 0;
+  while (filled < wanted) {
+    ssize_t count = pread(fd, &memory[(size_t) slot * blockSize] + filled, wanted - filled, start + filled);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) break;
+    filled += count;
+  }
+  stats.bytesRead += filled;
+  if (filled < wanted) {
+    blocks[slot] = -1;
+    freeSlots.push_back(slot);
+    return -1;
+  }
+
+  blocks[slot] = block;
+  lengths[slot] = filled;
+  slotOfBlock[block] = slot;
+  pushFront(slot);
+  return slot;
+}
+
+size_t blockCache::read(size_t offset, void *buffer, size_t length)
+{
+  if (offset >= fileSize) return 0;
+  length = min(length, fileSize - offset);
+  size_t copied = 0;
+  pthread_mutex_lock(&lock);
+  while (copied < length) {
+    size_t position = offset + copied;
+    int slot = acquireBlock(position / blockSize);
+    if (slot == -1) break;
+    size_t within = position % blockSize;
+    size_t count = min(length - copied, (size_t) lengths[slot] - within);
+    memcpy((char *) buffer + copied, &memory[(size_t) slot * blockSize] + within, count);
+    copied += count;
+  }
+  pthread_mutex_unlock(&lock);
+  return copied;
+}
+
+cacheStats blockCache::getStats() const
+{
+  pthread_mutex_lock(&lock);
+  cacheStats current = stats;
+  current.blocksCached = blocks.size() - freeSlots.size();
+  pthread_mutex_unlock(&lock);
+  return current;
+}
@@ -0,0 +1,113 @@
+#ifndef __block_cache__
+#define __block_cache__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+using namespace std;
+
+/**
+ * Convenience struct: cacheStats
+ * ------------------------------
+ * What a blockCache has done since it was created: how many block
+ * lookups found their block already cached (hits) and how many had to
+ * read it from the file (misses), how many cached blocks were dropped to
+ * make room (evictions), and how many bytes the misses read.  blocksCached
+ * and blockCapacity give how full the cache is and how many blocks it holds.
+ */
+
+struct cacheStats {
+  long hits;
+  long misses;
+  long evictions;
+  long bytesRead;
+  int blocksCached;
+  int blockCapacity;
+  cacheStats() : hits(0), misses(0), evictions(0), bytesRead(0), blocksCached(0), blockCapacity(0) {}
+  double hitRate() const { return hits + misses == 0 ? 0 : (double) hits / (hits + misses); }
+};
+
+/**
+ * Class: blockCache
+ * -----------------
+ * Reads a file through a fixed budget of memory rather than mapping all of
+ * it.  The file is divided into blocks of blockSize bytes, and up to
+ * budget / blockSize of them are kept in memory at once; a read that
+ * needs a block that isn't cached preads it, first evicting the least
+ * recently used block if the cache is full.  Every read is made under a
+ * lock, so one cache can serve any number of threads.
+ */
+
+class blockCache {
+ public:
+
+  /**
+   * Constant: kDefaultBlockSize
+   * ---------------------------
+   * The block size used unless another is asked for.
+   */
+
+  static const int kDefaultBlockSize = 16 * 1024;
+
+  /**
+   * Constructor: blockCache
+   * -----------------------
+   * Serves reads of the fileSize bytes of the open file fd, which the cache
+   * doesn't own, from at most budget bytes of blocks (but always at least
+   * one block).
+   */
+
+  blockCache(int fd, size_t fileSize, size_t budget, int blockSize = kDefaultBlockSize);
+  ~blockCache();
+
+  /**
+   * Method: read
+   * ------------
+   * Copies length bytes starting at the given offset into buffer, or as
+   * many of them as lie before the end of the file.
+   *
+   * @return the number of bytes copied, which falls short of length only
+   *         at the end of the file or if the file can't be read.
+   */
+
+  size_t read(size_t offset, void *buffer, size_t length);
+
+  /**
+   * Methods: getFileSize, getStats
+   * ------------------------------
+   * Return the size of the file being read, and the cache's counters.
+   */
+
+  size_t getFileSize() const { return fileSize; }
+  cacheStats getStats() const;
+
+ private:
+  int fd;
+  size_t fileSize;
+  int blockSize;
+
+  // slot i holds block blocks[i] (or -1 if it's free) in memory[i * blockSize],
+  // of which lengths[i] bytes are valid.  The slots holding blocks form a
+  // doubly linked list from the most recently used (head) to the least (tail).
+  vector<char> memory;
+  vector<int> blocks;
+  vector<int> lengths;
+  vector<int> newer, older;
+  int head, tail;
+  vector<int> freeSlots;
+
+  // the slot holding each block of the file, or -1 if it isn't cached
+  vector<int> slotOfBlock;
+
+  mutable pthread_mutex_t lock;
+  cacheStats stats;
+
+  int acquireBlock(int block);
+  void unlink(int slot);
+  void pushFront(int slot);
+
+  blockCache(const blockCache& original);
+  blockCache& operator=(const blockCache& rhs);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "degrees.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+const char *const degreeTable::kDegreeFileName = "degrees";
+
+/*
+ * The degree file opens with a header identifying the data it was built
+ * from, follows it with every actor's credit count, padded with a zero
+ * to an even number of counts, and ends with every movie's cast size.
+ */
+struct degreeHeader {
+  int magic;
+  int numActors;
+  int numMovies;
+};
+
+static const int kDegreeMagic = 0x44454731; // "DEG1"
+
+degreeTable::degreeTable(const imdb& db, const string& directory) :
+  db(db), fileSize(0), fileMap(NULL), credits(NULL), castSizes(NULL)
+{
+  const string fileName = directory + "/" + kDegreeFileName;
+  fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat stats;
+  if (fstat(fd, &stats) == -1) return;
+  fileSize = stats.st_size;
+  if (fileSize < sizeof(degreeHeader)) return;
+  void *map = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) return;
+  fileMap = map;
+
+  const degreeHeader *header = (const degreeHeader *) fileMap;
+  size_t paddedActors = (header->numActors + 1) / 2 * 2;
+  if (header->magic != kDegreeMagic || header->numActors != db.getNumActors() ||
+      header->numMovies != db.getNumMovies() ||
+      fileSize != sizeof(degreeHeader) +
+                  (paddedActors + header->numMovies) * sizeof(unsigned short)) return;
+  castSizes = (const unsigned short *) (header + 1) + paddedActors;
+  credits = (const unsigned short *) (header + 1);
+}
+
+degreeTable::~degreeTable()
+{
+  if (fileMap != NULL) munmap((void *) fileMap, fileSize);
+  if (fd != -1) close(fd);
+}
+
+void degreeTable::collect(const imdb& db, vector<unsigned short>& credits,
+			  vector<unsigned short>& castSizes)
+{
+  const int *ids;
+  credits.resize(db.getNumActors());
+  for (int i = 0; i < (int) credits.size(); i++)
+    credits[i] = db.getCreditIds(db.getActorIdAt(i), ids);
+  castSizes.resize(db.getNumMovies());
+  for (int i = 0; i < (int) castSizes.size(); i++)
+    castSizes[i] = db.getCastIds(db.getMovieIdAt(i), ids);
+}
+
+bool degreeTable::write(const string& directory, const vector<unsigned short>& credits,
+			const vector<unsigned short>& castSizes)
+{
+  degreeHeader header = { kDegreeMagic, (int) credits.size(), (int) castSizes.size() };
+  vector<unsigned short> paddedCredits(credits);
+  if (paddedCredits.size() % 2 != 0) paddedCredits.push_back(0);
+
+  const string fileName = directory + "/" + kDegreeFileName;
+  FILE *outfile = fopen(fileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool written =
+    fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+    fwrite(&paddedCredits[0], sizeof(unsigned short), paddedCredits.size(), outfile) == paddedCredits.size() &&
+    fwrite(&castSizes[0], sizeof(unsigned short), castSizes.size(), outfile) == castSizes.size();
+  if (fclose(outfile) != 0) written = false;
+  if (!written) remove(fileName.c_str());
+  return written;
+}
+
+bool degreeTable::build(const imdb& db, const string& directory)
+{
+  vector<unsigned short> credits, castSizes;
+  collect(db, credits, castSizes);
+  return write(directory, credits, castSizes);
+}
@@ -0,0 +1,89 @@
+#ifndef __degrees__
+#define __degrees__
+
+#include "imdb.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Class: degreeTable
+ * ------------------
+ * Every actor's number of credits and every movie's cast size, read
+ * from a sidecar file built by imdb-index (or imdb-degrees) so that
+ * searches can weigh a frontier by the work expanding it would take
+ * without touching the records of the actors on it.  The counts are
+ * stored as two flat arrays of unsigned shorts, by position, just as
+ * the records store them.
+ */
+
+class degreeTable {
+ public:
+
+  /**
+   * Constructor: degreeTable
+   * ------------------------
+   * Maps the degree file in the specified directory, provided it was
+   * built from the data files the specified imdb is layered over.
+   */
+
+  degreeTable(const imdb& db, const string& directory);
+  ~degreeTable();
+
+  /**
+   * Predicate Method: good
+   * ----------------------
+   * Returns true if and only if the degree file was loaded.
+   */
+
+  bool good() const { return credits != NULL; }
+
+  /**
+   * Methods: getCredits, getCreditsAt, getCastSizeAt
+   * ------------------------------------------------
+   * Return the number of credits of the identified actor (or of the actor
+   * at the given position), or the cast size of the movie at the given
+   * position.
+   */
+
+  int getCredits(int actorId) const { return credits[db.getActorPosition(actorId)]; }
+  int getCreditsAt(int position) const { return credits[position]; }
+  int getCastSizeAt(int position) const { return castSizes[position]; }
+
+  /**
+   * Static Method: collect
+   * ----------------------
+   * Reads every actor's credit count and every movie's cast size in one
+   * pass over the records, by position.
+   */
+
+  static void collect(const imdb& db, vector<unsigned short>& credits,
+		      vector<unsigned short>& castSizes);
+
+  /**
+   * Static Methods: write, build
+   * ----------------------------
+   * Write the collected counts to the degree file in the specified
+   * directory, collecting them first in the case of build.
+   *
+   * @return true if and only if the file was written successfully.
+   */
+
+  static bool write(const string& directory, const vector<unsigned short>& credits,
+		    const vector<unsigned short>& castSizes);
+  static bool build(const imdb& db, const string& directory);
+
+ private:
+  static const char *const kDegreeFileName;
+  const imdb& db;
+  int fd;
+  size_t fileSize;
+  const void *fileMap;
+  const unsigned short *credits;
+  const unsigned short *castSizes;
+
+  degreeTable(const degreeTable& original);
+  degreeTable& operator=(const degreeTable& rhs);
+};
+
+#endif
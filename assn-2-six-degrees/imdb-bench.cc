@@ -0,0 +1,335 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <new>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "imdb.h"
+#include "path.h"
+#include "search.h"
+using namespace std;
+
+/**
+ * Every allocation made through operator new (and so through every
+ * standard container and string) is counted here, so the benchmarks
+ * can report how many allocations each query makes.
+ */
+
+static long numAllocations = 0;
+
+void *operator new(size_t size)
+{
+  __atomic_add_fetch(&numAllocations, 1, __ATOMIC_RELAXED);
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == NULL) throw bad_alloc();
+  return memory;
+}
+
+void operator delete(void *memory) throw()
+{
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) throw()
+{
+  free(memory);
+}
+
+/**
+ * Constants: kDefaultNumSamples, kDefaultSeed
+ * -------------------------------------------
+ * How many actors, movies and pairs each benchmark samples unless told
+ * otherwise, and the seed that picks them, so runs are comparable.
+ */
+
+static const int kDefaultNumSamples = 1000;
+static const int kDefaultSeed = 107;
+
+/**
+ * Convenience struct: benchSample
+ * -------------------------------
+ * The randomly chosen queries every benchmark draws from: positions in
+ * the sorted actor and movie lists, along with the names and films at
+ * those positions, and the pairs of actors the path benchmark connects.
+ */
+
+struct benchSample {
+  vector<int> actorPositions;
+  vector<int> moviePositions;
+  vector<string> actors;
+  vector<film> movies;
+  vector<pair<string, string> > pairs;
+};
+
+/**
+ * Convenience struct: benchResult
+ * -------------------------------
+ * What one benchmark measured: the time each query took, and the
+ * allocations and page faults made over the whole run.
+ */
+
+struct benchResult {
+  vector<double> microseconds;
+  long allocations;
+  long minorFaults;
+  long majorFaults;
+};
+
+/**
+ * Class: imdbBenchmark
+ * --------------------
+ * Times the imdb's lookups, and the search built on them, one query at a
+ * time.  A friend of the imdb, so it can reach the records the extract
+ * methods expect without going through the name lookups that precede
+ * them in getCredits and getCast.
+ */
+
+class imdbBenchmark {
+ public:
+  imdbBenchmark(const imdb& db, const benchSample& sample) : db(db), sample(sample) {}
+  void run(ostream& out);
+
+ private:
+  const imdb& db;
+  const benchSample& sample;
+
+  const void *actorEntry(int position) const {
+    return (const int *) db.actorFile + 1 + position;
+  }
+
+  const void *movieRecord(int position) const {
+    return db.recordAt(db.movieFile, ((const int *) db.movieFile)[1 + position]);
+  }
+
+  static double microsecondsSince(const struct timespec& start);
+  void startRun(benchResult& result, struct rusage& usage) const;
+  void finishRun(benchResult& result, const struct rusage& usage) const;
+  void report(ostream& out, const char *name, benchResult& result) const;
+};
+
+double imdbBenchmark::microsecondsSince(const struct timespec& start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1e6 + (now.tv_nsec - start.tv_nsec) / 1e3;
+}
+
+void imdbBenchmark::startRun(benchResult& result, struct rusage& usage) const
+{
+  result.microseconds.clear();
+  result.microseconds.reserve(sample.pairs.size() + sample.actors.size() + sample.movies.size());
+  getrusage(RUSAGE_SELF, &usage);
+  result.allocations = __atomic_load_n(&numAllocations, __ATOMIC_RELAXED);
+}
+
+void imdbBenchmark::finishRun(benchResult& result, const struct rusage& usage) const
+{
+  result.allocations = __atomic_load_n(&numAllocations, __ATOMIC_RELAXED) - result.allocations;
+  struct rusage now;
+  getrusage(RUSAGE_SELF, &now);
+  result.minorFaults = now.ru_minflt - usage.ru_minflt;
+  result.majorFaults = now.ru_majflt - usage.ru_majflt;
+}
+
+/**
+ * Prints one line per benchmark: the latency percentiles in microseconds,
+ * then the allocations per query and the page faults over the whole run.
+ */
+
+void imdbBenchmark::report(ostream& out, const char *name, benchResult& result) const
+{
+  vector<double>& times = result.microseconds;
+  if (times.empty()) return;
+  sort(times.begin(), times.end());
+  double total = 0;
+  for (int i = 0; i < (int) times.size(); i++) total += times[i];
+  int n = times.size();
+  out << left << setw(22) << name << right << fixed << setprecision(2)
+      << " n " << setw(5) << n
+      << "  mean " << setw(9) << total / n
+      << "  p50 " << setw(9) << times[n / 2]
+      << "  p90 " << setw(9) << times[n * 9 / 10]
+      << "  p99 " << setw(9) << times[n * 99 / 100]
+      << "  max " << setw(9) << times[n - 1] << " us"
+      << "  allocs/query " << setw(7) << (double) result.allocations / n
+      << "  faults " << result.minorFaults << " minor, " << result.majorFaults << " major" << endl;
+}
+
+/**
+ * Runs each benchmark in turn over the same sample.  The allocation
+ * counts include the growth of the vectors the queries fill, which are
+ * declared outside the timed loops and reused the way callers reuse them.
+ * The path benchmark does what six-degrees' generateShortestPath does,
+ * except that it formats the path into a string rather than the terminal.
+ */
+
+void imdbBenchmark::run(ostream& out)
+{
+  benchResult result;
+  struct rusage usage;
+  struct timespec start;
+  vector<film> films;
+  vector<string> players;
+
+  startRun(result, usage);
+  for (int i = 0; i < (int) sample.actors.size(); i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    db.getCredits(sample.actors[i], films);
+    result.microseconds.push_back(microsecondsSince(start));
+  }
+  finishRun(result, usage);
+  report(out, "getCredits", result);
+
+  startRun(result, usage);
+  for (int i = 0; i < (int) sample.movies.size(); i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    db.getCast(sample.movies[i], players);
+    result.microseconds.push_back(microsecondsSince(start));
+  }
+  finishRun(result, usage);
+  report(out, "getCast", result);
+
+  startRun(result, usage);
+  for (int i = 0; i < (int) sample.actorPositions.size(); i++) {
+    const void *entry = actorEntry(sample.actorPositions[i]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    db.extractFilms(entry, films);
+    result.microseconds.push_back(microsecondsSince(start));
+  }
+  finishRun(result, usage);
+  report(out, "extractFilms", result);
+
+  startRun(result, usage);
+  for (int i = 0; i < (int) sample.moviePositions.size(); i++) {
+    const void *record = movieRecord(sample.moviePositions[i]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    db.extractCast(record, players);
+    result.microseconds.push_back(microsecondsSince(start));
+  }
+  finishRun(result, usage);
+  report(out, "extractCast", result);
+
+  searchOptions options;
+  startRun(result, usage);
+  for (int i = 0; i < (int) sample.pairs.size(); i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    path shortestPath(sample.pairs[i].first);
+    searchStats stats;
+    ostringstream formatted;
+    if (findShortestPath(db, db.getActorId(sample.pairs[i].first),
+			 db.getActorId(sample.pairs[i].second), options, shortestPath, stats))
+      formatted << shortestPath;
+    result.microseconds.push_back(microsecondsSince(start));
+  }
+  finishRun(result, usage);
+  report(out, "generateShortestPath", result);
+}
+
+/**
+ * Draws the sample with erand48 from a fixed seed, so the same seed and
+ * data always yield the same queries.
+ */
+
+static void drawSample(const imdb& db, int numSamples, int seed, benchSample& sample)
+{
+  unsigned short state[3] = { 0x330e, (unsigned short) seed, (unsigned short) (seed >> 16) };
+  int numActors = db.getNumActors(), numMovies = db.getNumMovies();
+  for (int i = 0; i < numSamples; i++) {
+    int actorPosition = (int) (erand48(state) * numActors);
+    int moviePosition = (int) (erand48(state) * numMovies);
+    sample.actorPositions.push_back(actorPosition);
+    sample.moviePositions.push_back(moviePosition);
+    sample.actors.push_back(db.getActorName(db.getActorIdAt(actorPosition)));
+    sample.movies.push_back(db.getFilm(db.getMovieIdAt(moviePosition)));
+  }
+
+  for (int i = 0; i < numSamples; i++) {
+    string source = sample.actors[i];
+    string target = sample.actors[(int) (erand48(state) * numSamples)];
+    sample.pairs.push_back(make_pair(source, target));
+  }
+}
+
+static void usage(const char *program)
+{
+  cerr << "Usage: " << program << " [--samples <n>] [--seed <n>]" << endl
+       << "       [--adjacency-index] [--name-index] [--movie-tree]" << endl
+       << "       [--cache-mb <n> [--cache-block <bytes>]] [data-directory]" << endl;
+  exit(1);
+}
+
+/**
+ * Function: main
+ * --------------
+ * Defines the entry point for the imdb benchmarks, run by "make bench-imdb".
+ * Samples actors, movies and pairs of actors at random (but reproducibly)
+ * from the data in the specified directory (or in the default data
+ * directory, if none is given), and times getCredits, getCast,
+ * extractFilms, extractCast and a full shortest path query over them.
+ * Flags:
+ *
+ *     --samples <n>       the number of queries each benchmark makes
+ *     --seed <n>          picks a different sample
+ *     --adjacency-index, --name-index, --movie-tree
+ *                         load the imdb with the corresponding option
+ *     --cache-mb <n>      read the data through a block cache of n megabytes,
+ *                         and report its hit rates after the benchmarks
+ *     --cache-block <bytes>  the size of the blocks the cache reads
+ */
+
+int main(int argc, char **argv)
+{
+  const char *dataPath = NULL;
+  int numSamples = kDefaultNumSamples;
+  int seed = kDefaultSeed;
+  imdbOptions options;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0) {
+      if (++i == argc || (numSamples = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      if (++i == argc) usage(argv[0]);
+      seed = atoi(argv[i]);
+    } else if (strcmp(argv[i], "--adjacency-index") == 0) {
+      options.useAdjacencyIndex = true;
+    } else if (strcmp(argv[i], "--name-index") == 0) {
+      options.useNameIndex = true;
+    } else if (strcmp(argv[i], "--movie-tree") == 0) {
+      options.useMovieTree = true;
+    } else if (strcmp(argv[i], "--cache-mb") == 0) {
+      if (++i == argc || atoi(argv[i]) < 1) usage(argv[0]);
+      options.cacheBudget = (size_t) atoi(argv[i]) << 20;
+    } else if (strcmp(argv[i], "--cache-block") == 0) {
+      if (++i == argc || (options.cacheBlockSize = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+    } else {
+      dataPath = argv[i];
+    }
+  }
+
+  imdb db(determinePathToData(dataPath), options);
+  if (!db.good() || db.getNumActors() == 0 || db.getNumMovies() == 0) {
+    cerr << "Failed to properly initialize the imdb database." << endl;
+    return 1;
+  }
+
+  benchSample sample;
+  drawSample(db, numSamples, seed, sample);
+  cout << numSamples << " samples per benchmark, seed " << seed << endl;
+  imdbBenchmark benchmark(db, sample);
+  benchmark.run(cout);
+
+  cacheStats actors, movies;
+  if (db.getCacheStats(actors, movies)) {
+    cout << fixed << setprecision(1) 
+	 << "block cache hit rate: actors " << 100 * actors.hitRate() << "% (" << actors.misses 
+	 << " misses), movies " << 100 * movies.hitRate() << "% (" << movies.misses << " misses)" << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include "imdb.h"
+#include "degrees.h"
+using namespace std;
+
+/**
+ * Constant: kDefaultNumHubs
+ * -------------------------
+ * How many of the best-connected actors and movies are listed unless
+ * told otherwise.
+ */
+
+static const int kDefaultNumHubs = 10;
+
+/**
+ * Prints the count, the total, the mean, the median and the maximum of
+ * the degrees, and then a histogram of them in power-of-two buckets
+ * (1, 2-3, 4-7, and so on, with 0 on its own), giving the share of nodes
+ * and the share of edges in each bucket as well as the running share.
+ */
+
+static void printHistogram(const char *title, const vector<unsigned short>& degrees)
+{
+  vector<unsigned short> sorted(degrees);
+  sort(sorted.begin(), sorted.end());
+  long long total = 0;
+  for (int i = 0; i < (int) sorted.size(); i++) total += sorted[i];
+  int n = sorted.size();
+
+  cout << title << ": " << n << " nodes, " << total << " edges";
+  if (n > 0) {
+    cout << fixed << setprecision(2) << ", mean " << (double) total / n
+	 << ", median " << sorted[n / 2] << ", max " << sorted[n - 1];
+  }
+  cout << endl;
+  if (n == 0) return;
+
+  vector<int> nodes(18, 0);
+  vector<long long> edges(18, 0);
+  for (int i = 0; i < n; i++) {
+    int bucket = 0;
+    while (bucket < 17 && sorted[i] >= (1 << bucket)) bucket++;
+    nodes[bucket]++;
+    edges[bucket] += sorted[i];
+  }
+
+  double cumulative = 0;
+  for (int bucket = 0; bucket < 18; bucket++) {
+    if (nodes[bucket] == 0) continue;
+    int low = bucket == 0 ? 0 : 1 << (bucket - 1), high = bucket == 0 ? 0 : (1 << bucket) - 1;
+    cumulative += 100.0 * nodes[bucket] / n;
+    cout << setw(8) << low << " - " << left << setw(8) << high << right
+	 << setw(10) << nodes[bucket] << " nodes " << setw(6) << setprecision(2)
+	 << 100.0 * nodes[bucket] / n << "% (" << setw(6) << cumulative << "% cumulative), "
+	 << setw(6) << (total == 0 ? 0.0 : 100.0 * edges[bucket] / total) << "% of edges" << endl;
+  }
+}
+
+/**
+ * Comparison function: byDegree
+ * -----------------------------
+ * Orders (degree, position) pairs with the highest degree first, breaking
+ * ties by position so the listing is reproducible.
+ */
+
+static bool byDegree(const pair<int, int>& a, const pair<int, int>& b)
+{
+  return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+/**
+ * Lists the numHubs actors (or, if actors is false, movies) of highest degree.
+ */
+
+static void printHubs(const char *title, const vector<unsigned short>& degrees, int numHubs,
+		      const imdb& db, bool actors)
+{
+  vector<pair<int, int> > ranked;
+  for (int i = 0; i < (int) degrees.size(); i++) ranked.push_back(make_pair(degrees[i], i));
+  numHubs = min(numHubs, (int) ranked.size());
+  partial_sort(ranked.begin(), ranked.begin() + numHubs, ranked.end(), byDegree);
+
+  cout << title << ":" << endl;
+  for (int i = 0; i < numHubs; i++) {
+    cout << setw(6) << ranked[i].first << "  ";
+    if (actors) {
+      cout << db.getActorName(db.getActorIdAt(ranked[i].second)) << endl;
+    } else {
+      film movie = db.getFilm(db.getMovieIdAt(ranked[i].second));
+      cout << movie.title << " (" << movie.year << ")" << endl;
+    }
+  }
+}
+
+/**
+ * Function: main
+ * --------------
+ * Defines the entry point for the degree analyzer.  Reads the credit count
+ * of every actor and the cast size of every movie in the specified
+ * directory (or in the default data directory, if none is given) in a
+ * single pass, prints their distributions and the best-connected actors
+ * and movies, and writes the counts to the degree file that six-degrees'
+ * --degrees flag loads.  Flags:
+ *
+ *     --top <n>      the number of actors and movies to list (default 10)
+ *     --no-write     just report, without writing the degree file
+ */
+
+int main(int argc, char **argv)
+{
+  const char *dataPath = NULL;
+  int numHubs = kDefaultNumHubs;
+  bool writeFile = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+      numHubs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--no-write") == 0) {
+      writeFile = false;
+    } else if (argv[i][0] == '-') {
+      cerr << "Usage: " << argv[0] << " [--top <n>] [--no-write] [data-directory]" << endl;
+      return 1;
+    } else {
+      dataPath = argv[i];
+    }
+  }
+
+  const char *directory = determinePathToData(dataPath);
+  imdb db(directory);
+  if (!db.good()) {
+    cerr << "Failed to properly initialize the imdb database in " << directory << "." << endl;
+    return 1;
+  }
+
+  vector<unsigned short> credits, castSizes;
+  degreeTable::collect(db, credits, castSizes);
+  printHistogram("Credits per actor", credits);
+  cout << endl;
+  printHistogram("Cast size per movie", castSizes);
+  cout << endl;
+  printHubs("Actors with the most credits", credits, numHubs, db, true);
+  cout << endl;
+  printHubs("Movies with the largest casts", castSizes, numHubs, db, false);
+
+  if (!writeFile) return 0;
+  if (!degreeTable::write(directory, credits, castSizes)) {
+    cerr << "Failed to write the degree file in " << directory << "." << endl;
+    return 1;
+  }
+  cout << endl << "Wrote the degrees to " << directory << "." << endl;
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "imdb.h"
+#include "landmarks.h"
+#include "degrees.h"
+using namespace std;
+
+/**
+ * Constant: kDefaultNumLandmarks
+ * ------------------------------
+ * How many landmarks the landmark file records unless told otherwise.
+ */
+
+static const int kDefaultNumLandmarks = 16;
+
+/**
+ * Function: main
+ * --------------
+ * Defines the entry point for the offline step that precomputes the
+ * adjacency index, the actor name index, the degree file and the landmark
+ * distances for the data files in the specified directory (or in the
+ * default data directory, if none is given).  These only need to be
+ * rebuilt when the data files change; see imdb::buildAdjacencyIndex,
+ * imdb::buildNameIndex, degreeTable::build and landmarkOracle::build.  Flags:
+ *
+ *     --landmarks <k>   the number of landmarks to record (0 skips them)
+ *     --threads <n>     the number of threads each landmark's search uses
+ */
+
+int main(int argc, char **argv)
+{
+  const char *dataPath = NULL;
+  int numLandmarks = kDefaultNumLandmarks;
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--landmarks") == 0 && i + 1 < argc) {
+      numLandmarks = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      cerr << "Usage: " << argv[0] << " [--landmarks <k>] [--threads <n>] [data-directory]" << endl;
+      return 1;
+    } else {
+      dataPath = argv[i];
+    }
+  }
+
+  const char *directory = determinePathToData(dataPath);
+  if (!imdb::buildAdjacencyIndex(directory)) {
+    cerr << "Failed to build the adjacency index in " << directory << "." << endl;
+    return 1;
+  }
+  
+  if (!imdb::buildNameIndex(directory)) {
+    cerr << "Failed to build the actor name index in " << directory << "." << endl;
+    return 1;
+  }
+  
+  cout << "Wrote the adjacency and actor name indices to " << directory << "." << endl;
+
+  imdb plain(directory);
+  if (!plain.good() || !degreeTable::build(plain, directory)) {
+    cerr << "Failed to build the degree file in " << directory << "." << endl;
+    return 1;
+  }
+  cout << "Wrote the degrees to " << directory << "." << endl;
+  if (numLandmarks <= 0) return 0;
+
+  imdbOptions options;
+  options.useAdjacencyIndex = true;
+  imdb db(directory, options);
+  if (!db.good() || !landmarkOracle::build(db, directory, numLandmarks, numThreads)) {
+    cerr << "Failed to build the landmark distances in " << directory << "." << endl;
+    return 1;
+  }
+
+  cout << "Wrote the distances from " << numLandmarks << " landmarks to " << directory << "." << endl;
+  return 0;
+}
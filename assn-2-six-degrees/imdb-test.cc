@@ -70,6 +70,48 @@ static void listMovies(const string& player, const vector<film>& credits)
   stall();
 }
 
+/**
+ * Comparison functor: costarOrder
+ * -------------------------------
+ * Orders costar names (which point straight into the imdb's memory) 
+ * alphabetically, just as the strings they stand for would be ordered.
+ */
+
+struct costarOrder {
+  bool operator()(const char *one, const char *two) const { return strcmp(one, two) < 0; }
+};
+
+typedef map<const char *, set<film>, costarOrder> costarMap;
+
+/**
+ * Convenience struct: costarCollector
+ * -----------------------------------
+ * The auxData handed to addCostar: the player whose costars are being
+ * collected, the movie whose cast is being visited, and the costars
+ * collected so far.
+ */
+
+struct costarCollector {
+  const string *player;
+  const film *movie;
+  costarMap *costars;
+};
+
+/**
+ * Function: addCostar
+ * -------------------
+ * castVisitor that records the specified member of a cast as one of the
+ * collector's player's costars in the collector's movie.  Names are kept
+ * as the pointers imdb::visitCast hands over, so nothing is copied.
+ */
+
+static void addCostar(const char *costar, int length, void *auxData)
+{
+  costarCollector *collector = (costarCollector *) auxData;
+  if (collector->player->compare(costar) != 0) 
+    (*collector->costars)[costar].insert(*collector->movie);
+}
+
 /**
  * Function: listCostars
  * ---------------------
@@ -90,24 +132,20 @@ static void listMovies(const string& player, const vector<film>& credits)
 static void listCostars(const string &player, const vector<film>& credits, const imdb& db)
 {
   const unsigned int kNumCostarsToPrint = 10;
-  map<string, set<film> > costars;
+  costarMap costars;
+  costarCollector collector = { &player, NULL, &costars };
   for (int i = 0; i < (int) credits.size(); i++) {
-    const film& movie = credits[i];
-    vector<string> cast;
-    db.getCast(movie, cast);
-    for (int j = 0; j < (int) cast.size(); j++) {
-      const string& costar = cast[j];
-      if (costar != player) costars[costar].insert(movie);
-    }
+    collector.movie = &credits[i];
+    db.visitCast(credits[i], addCostar, &collector);
   }
   
   cout << player << " has worked with " << (int) costars.size() << " other people." << endl;
   cout << "Those other people are:" << endl;
   
   unsigned int numCostars = 0;
-  map<string, set<film> >::const_iterator curr;
+  costarMap::const_iterator curr;
   for (curr = costars.begin(); curr != costars.end() && numCostars < kNumCostarsToPrint; ++curr) {
-    const string& costar = curr->first;
+    const char *costar = curr->first;
     cout << setw(5) << ++numCostars << ".) " << costar;
     if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
     cout << endl;
@@ -117,7 +155,7 @@ static void listCostars(const string &player, const vector<film>& credits, const
     if (costars.size() > 2 * kNumCostarsToPrint) printFill();
     while (numCostars < costars.size() - kNumCostarsToPrint) { numCostars++; ++curr; }
     for (; curr != costars.end(); ++curr) {
-      const string& costar = curr->first;
+      const char *costar = curr->first;
       cout << setw(5) << ++numCostars << ".) " << costar;
       if (curr->second.size() > 1) cout << " (in " << (int) curr->second.size() << " different films)";
       cout << endl;
@@ -5,6 +5,9 @@
 #include <string>
 #include <iostream>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 using namespace std;
 
 /**
@@ -53,7 +56,8 @@ struct film {
  * the resident OS is Linux or Solaris.  For our purposes, this
  * tells us whether the machine is big-endian or little-endian, and
  * the endiannees tells us which set of raw binary data files we should
- * be using.
+ * be using.  (Either set works anywhere, since the imdb converts files in
+ * the other byte order once, but the matching set needs no conversion.)
  *
  * @return one of two data paths.
  */
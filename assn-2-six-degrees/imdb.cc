@@ -4,43 +4,199 @@ using namespace std;
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
 #include "imdb.h"
 
 const char *const imdb::kActorFileName = "actordata";
 const char *const imdb::kMovieFileName = "moviedata";
+const char *const imdb::kAdjacencyFileName = "adjacency-index";
+const char *const imdb::kNameIndexFileName = "actor-name-index";
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const char *const imdb::kNativeCacheSuffix = ".big-endian";
+#else
+const char *const imdb::kNativeCacheSuffix = ".little-endian";
+#endif
 
-imdb::imdb(const string& directory)
+/*
+ * The adjacency index opens with a header identifying the data files it
+ * was built from, so an index left behind by some other database is
+ * never mistaken for the current one.  The header is followed by the
+ * actor table's row starts (numActors + 1 of them) and neighbors, and
+ * then by the movie table's row starts and neighbors, all native ints.
+ */
+struct adjacencyHeader {
+  int magic;
+  int numActors;
+  int numMovies;
+  int actorFileSize;
+  int movieFileSize;
+  int numCredits;
+};
+
+static const int kAdjacencyMagic = 0x43535231; // "CSR1"
+
+/*
+ * The name index opens with a header of its own, followed by numSlots
+ * (hash, position) pairs.  Empty slots hold a position of -1.
+ */
+struct nameIndexHeader {
+  int magic;
+  int numActors;
+  int actorFileSize;
+  int numSlots;
+};
+
+static const int kNameIndexMagic = 0x4e414d31; // "NAM1"
+
+/*
+ * Returns the number of milliseconds elapsed since the specified start time.
+ */
+static double millisecondsSince(const struct timeval& start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+imdb::imdb(const string& directory, const imdbOptions& options)
 {
   const string actorFileName = directory + "/" + kActorFileName;
   const string movieFileName = directory + "/" + kMovieFileName;
   
-  actorFile = acquireFileMap(actorFileName, actorInfo);
-  movieFile = acquireFileMap(movieFileName, movieInfo);
+  requested = options;
+  actorCache = movieCache = NULL;
+  if (options.cacheBudget == 0) {
+    actorFile = acquireDataFile(actorFileName, actorInfo, false);
+    movieFile = acquireDataFile(movieFileName, movieInfo, true);
+  } else {
+    actorFile = acquireCachedDataFile(actorFileName, actorInfo, false, actorHeader);
+    movieFile = acquireCachedDataFile(movieFileName, movieInfo, true, movieHeader);
+    createBlockCaches();
+  }
+
+  useAdjacencyIndex = useNameIndex = false;
+  adjacencyInfo.fd = nameIndexInfo.fd = -1;
+  adjacencyInfo.fileMap = nameIndexInfo.fileMap = NULL;
+  adjacencyInfo.fileSize = nameIndexInfo.fileSize = 0;
+  if (options.useAdjacencyIndex) 
+    useAdjacencyIndex = loadAdjacencyIndex(directory + "/" + kAdjacencyFileName);
+  if (options.useNameIndex)
+    useNameIndex = loadNameIndex(directory + "/" + kNameIndexFileName);
+  if (options.useMovieTree && movieInfo.fd != -1)
+    buildMovieTree();
+  if (options.useYearTable && movieInfo.fd != -1)
+    buildYearTable();
 }
 
 bool imdb::good() const
 {
   return !( (actorInfo.fd == -1) || 
-	    (movieInfo.fd == -1) ); 
+	    (movieInfo.fd == -1) ||
+	    (requested.useAdjacencyIndex && !useAdjacencyIndex) ||
+	    (requested.useNameIndex && !useNameIndex) ); 
 }
 
 /*
  * A pair is needed to be passed to both the actor and movie comparison
  * functions because both of the functions need both a pointer to the
- * memory file and a pointer to the key.
+ * memory file and a pointer to the key (along with the imdb, which knows
+ * how to get at the records in the file).
  */
 struct cmpPair {
   const void *key;
   const void *recBlob;
+  const imdb *db;
 };
 
+/*
+ * Each thread reading through the block caches gets a buffer per file to
+ * read records into, freed when the thread exits.
+ */
+struct recordScratch {
+  vector<char> buffers[2]; // the actor file's, then the movie file's
+};
+
+static void releaseScratch(void *scratch)
+{
+  delete (recordScratch *) scratch;
+}
+
+/*
+ * How much of a record is read at first, in the hope that it's enough to
+ * hold the name and the count and so the size of the whole record.
+ */
+static const size_t kRecordPeek = 64;
+
 /*
  * Returns a pointer to the specific actor or movie record if given a
- * memory file and integer offset in bytes.
+ * memory file and integer offset in bytes.  When the file is read through
+ * a block cache, the record is read into the calling thread's buffer for
+ * that file, and the pointer is good until the thread reads another
+ * record from the same file.
+ */
+const char *imdb::recordAt(const void *file, int offset) const
+{
+  blockCache *cache = file == actorFile ? actorCache : movieCache;
+  if (cache == NULL) return (const char *) file + offset;
+  return readRecord(cache, file == movieFile, offset);
+}
+
+/*
+ * Makes sure the first length bytes of the record at the given offset
+ * have been read into the buffer, starting shift bytes in, and returns
+ * the address of the record there.  filled counts the bytes read so far.
+ */
+static char *fillRecord(blockCache *cache, vector<char>& buffer, size_t shift,
+			int offset, size_t& filled, size_t length)
+{
+  if (buffer.size() < shift + length) buffer.resize(shift + length);
+  if (filled < length) 
+    filled += cache->read(offset + filled, &buffer[shift + filled], length - filled);
+  return &buffer[shift];
+}
+
+/*
+ * Reads the record at the given offset through the cache, a piece at a
+ * time: enough to find the end of the name, then enough to hold the count,
+ * and then the rest.  The record is placed at an address congruent to its
+ * offset modulo 8, just as it would be in a mapping of the file, so that
+ * the padding the code below works out from addresses comes out the same.
  */
-static char *getRecord(const void *recBlob, const void *offset)
+const char *imdb::readRecord(blockCache *cache, bool isMovieFile, int offset) const
 {
-  return (char *) (recBlob) + * (int *) offset;
+  recordScratch *scratch = (recordScratch *) pthread_getspecific(scratchKey);
+  if (scratch == NULL) {
+    scratch = new recordScratch;
+    pthread_setspecific(scratchKey, scratch);
+  }
+  vector<char>& buffer = scratch->buffers[isMovieFile];
+  size_t shift = offset % 8;
+  size_t limit = cache->getFileSize() - offset;
+  size_t filled = 0;
+
+  size_t length = min(kRecordPeek, limit);
+  char *record = fillRecord(cache, buffer, shift, offset, filled, length);
+  const char *nameEnd;
+  while ((nameEnd = (const char *) memchr(record, '\0', filled)) == NULL && 
+	 filled == length && length < limit) {
+    length = min(2 * length, limit);
+    record = fillRecord(cache, buffer, shift, offset, filled, length);
+  }
+  if (nameEnd == NULL) return record;
+
+  size_t size = nameEnd + 1 - record + (isMovieFile ? 1 : 0); // the movie's year byte
+  size += size % 2;
+  record = fillRecord(cache, buffer, shift, offset, filled, min(size + sizeof(short), limit));
+  if (filled < size + sizeof(short)) return record;
+  short count = * (const short *) (record + size);
+  if (count < 0) return record;
+  size += sizeof(short);
+  size += size % 4;
+  return fillRecord(cache, buffer, shift, offset, filled, min(size + count * sizeof(int), limit));
 }
 
 /* 
@@ -86,6 +242,19 @@ film movieRecToFilm(const void *movieRec)
   return filmStr;
 }
 
+/*
+ * Given a pointer to a movie record, returns a filmRef describing the
+ * title and year of the movie in place.
+ */
+static filmRef movieRecToFilmRef(const void *movieRec)
+{
+  const unsigned char *yearDelta = movieYearOffset(movieRec);
+  filmRef ref = { (const char *) movieRec, 
+		  (int) ((const char *) yearDelta - (const char *) movieRec) - 1,
+		  1900 + *yearDelta };
+  return ref;
+}
+
 /*
  * Comparison function to be used when searching the actor array.
  * The key is an actor name.
@@ -93,10 +262,46 @@ film movieRecToFilm(const void *movieRec)
 int actorCmpFn(const void *keyPtr, const void *elem)
 {
   cmpPair keyPair = * (cmpPair *) keyPtr;
-  char *elemName = getRecord(keyPair.recBlob, elem);
+  const char *elemName = keyPair.db->recordAt(keyPair.recBlob, * (const int *) elem);
   return strcmp((*(string *) keyPair.key).c_str(), elemName);
 }
 
+/*
+ * Given a pointer to an actor record, returns the address of the record's
+ * array of movie offsets and sets numCredits to its length.
+ */
+static const int *actorMovieOffsets(const void *actorRec, int& numCredits)
+{
+  short *numCreditsPtr = (short *) actorNameEnd(actorRec);
+  int *filmElemArray = (int *) (numCreditsPtr + 1);
+  // need to move the pointer over two bytes if it is not a multiple of four
+  int additionalPadding = ((char *) filmElemArray - (char *) actorRec) % 4;
+  numCredits = *numCreditsPtr;
+  return (int *) ((char *) filmElemArray + additionalPadding);
+}
+
+/*
+ * Given a pointer to a movie record, returns the address of the record's
+ * array of actor offsets and sets numActors to its length.
+ */
+static const int *movieActorOffsets(const void *movieRec, int& numActors)
+{
+  // first traverse the record to find the number of actors and start of the
+  // actor record offset values 
+  char *iter = (char *) movieRec;
+  while (*iter)
+    iter++;
+  iter += 2; // the \0 and the one-byte year offset
+  iter += (iter - (char *) movieRec) % 2; // padding in case the offset is odd
+
+  short *numActorsPtr = (short *) iter;
+  int *actorOffsets = (int *) (numActorsPtr + 1);
+  // need to move the pointer over two bytes if it is not a multiple of four
+  int additionalPadding = ((char *) actorOffsets - (char *) movieRec) % 4;
+  numActors = *numActorsPtr;
+  return (int *) ((char *) actorOffsets + additionalPadding);
+}
+
 /*
  * If given a pointer to an offset of an actor record, will populate the
  * given films vector with all of the films for that actor.  Any existing
@@ -104,16 +309,13 @@ int actorCmpFn(const void *keyPtr, const void *elem)
  */
 void imdb::extractFilms(const void *offset, vector<film>& films) const
 {
-  void *actorRec = getRecord(actorFile, offset);
-  short *numCredits = (short *) actorNameEnd(actorRec);
-  int *filmElemArray = (int *) (numCredits + 1);
-  // need to move the pointer over two bytes if it is not a multiple of four
-  int additionalPadding = ((char *) filmElemArray - (char *) actorRec) % 4;
-  filmElemArray = (int *) ((char *) filmElemArray + additionalPadding);
+  const void *actorRec = recordAt(actorFile, * (const int *) offset);
+  int numCredits;
+  const int *filmElemArray = actorMovieOffsets(actorRec, numCredits);
   
   films.clear();
-  for (int i = 0; i < *numCredits; i++) {
-    void *movieRec = getRecord(movieFile, filmElemArray + i); 
+  for (int i = 0; i < numCredits; i++) {
+    const void *movieRec = recordAt(movieFile, filmElemArray[i]);
     films.push_back(movieRecToFilm(movieRec));
   }
 }
@@ -130,7 +332,7 @@ void *imdb::searchFile(const void *file, const void *key,
 
   // create a pair that needs to be passed into bsearch containing the
   //  name and a pointer to the record file 
-  cmpPair keyPair = { key, file };
+  cmpPair keyPair = { key, file, this };
   return bsearch(&keyPair, base, numRecords, sizeof(int), cmpFn);
 }
 
@@ -141,7 +343,7 @@ void *imdb::searchFile(const void *file, const void *key,
  */
 bool imdb::getCredits(const string& player, vector<film>& films) const
 { 
-  void *found = searchFile(actorFile, &player, actorCmpFn);
+  const void *found = findActorEntry(player);
   
   if (found) {
     extractFilms(found, films);
@@ -151,24 +353,131 @@ bool imdb::getCredits(const string& player, vector<film>& films) const
   }
 }
 
+/*
+ * Hashes a name with 32-bit FNV-1a, which is quick and spreads the
+ * similar-looking names in the actor file evenly across the table.
+ */
+static unsigned int hashName(const char *name)
+{
+  unsigned int hash = 2166136261u;
+  for (; *name != '\0'; name++) {
+    hash ^= (unsigned char) *name;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Returns the address of the specified actor's entry in the actor file's
+ * array of record offsets, or NULL if there's no such actor.  Probes the
+ * name index when it's loaded, and binary searches the actor file otherwise.
+ */
+const void *imdb::findActorEntry(const string& player) const
+{
+  if (!useNameIndex) return searchFile(actorFile, &player, actorCmpFn);
+
+  const int *offsets = (const int *) actorFile + 1;
+  unsigned int hash = hashName(player.c_str());
+  for (unsigned int i = hash & nameSlotMask; nameSlots[i].position != -1; i = (i + 1) & nameSlotMask) {
+    if (nameSlots[i].hash != hash) continue;
+    const int *entry = offsets + nameSlots[i].position;
+    if (strcmp(player.c_str(), recordAt(actorFile, *entry)) == 0) return entry;
+  }
+  return NULL;
+}
+
+/*
+ * Compares the key film against the film stored in the specified movie
+ * record, in the same order film::operator< imposes, reading the title and
+ * year straight out of the record rather than building a film from it.
+ */
+static int compareFilmToRecord(const film& key, const void *movieRec)
+{
+  int cmp = strcmp(key.title.c_str(), (const char *) movieRec);
+  if (cmp != 0) return cmp;
+  return key.year - (1900 + *movieYearOffset(movieRec));
+}
+
 /*
  * Comparison function to be used when searching the movie array.  Uses 
  * a film as the key type.
  */
 int movieCmpFn(const void *keyPtr, const void *elem)
 {
-  cmpPair keyPair = * (cmpPair *) keyPtr;
-  film key = * (film *) keyPair.key;
-  void *testMovieRec = getRecord(keyPair.recBlob, elem);
-  film test = movieRecToFilm(testMovieRec);
-  
-  if (key == test) {
-    return 0;
-  } else if (key < test) {
-    return -1;
-  } else {
-    return 1;
+  const cmpPair *keyPair = (const cmpPair *) keyPtr;
+  return compareFilmToRecord(* (const film *) keyPair->key,
+			     keyPair->db->recordAt(keyPair->recBlob, * (const int *) elem));
+}
+
+/*
+ * Packs the first eight characters of a title (padded with '\0's) into an
+ * integer, most significant byte first, so that comparing two prefixes as
+ * integers orders them just as strcmp would order the titles, except that
+ * titles sharing all eight characters compare equal.
+ */
+static unsigned long long titlePrefix(const char *title)
+{
+  unsigned long long prefix = 0;
+  int i = 0;
+  for (; i < 8 && title[i] != '\0'; i++) 
+    prefix = (prefix << 8) | (unsigned char) title[i];
+  return prefix << (8 * (8 - i));
+}
+
+/*
+ * Lays out the sorted positions from position onwards in Eytzinger (breadth-
+ * first binary tree) order within the subtree rooted at node k, where node
+ * k's children are nodes 2k and 2k + 1.  Returns the position to be placed next.
+ */
+int imdb::layoutMovieTree(int position, int k)
+{
+  if (k >= (int) movieTree.size()) return position;
+  position = layoutMovieTree(position, 2 * k);
+  const int *offsets = (const int *) movieFile + 1;
+  movieTree[k].prefix = titlePrefix(recordAt(movieFile, offsets[position]));
+  movieTree[k].position = position;
+  return layoutMovieTree(position + 1, 2 * k + 1);
+}
+
+void imdb::buildMovieTree()
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  movieTree.resize(getNumMovies() + 1); // node 0 goes unused
+  layoutMovieTree(0, 1);
+  loadStep step = { "build the movie search tree", millisecondsSince(start), true };
+  loadSteps.push_back(step);
+}
+
+/*
+ * Returns the address of the specified movie's entry in the movie file's
+ * array of record offsets, or NULL if there's no such movie.  Descends the
+ * Eytzinger tree when it's been built, and binary searches the movie file
+ * otherwise.  The descent always runs the full height of the tree and
+ * looks for the first movie not less than the key; the prefixes settle
+ * nearly every comparison without touching a record.
+ */
+const void *imdb::findMovieEntry(const film& movie) const
+{
+  if (movieTree.empty()) return searchFile(movieFile, &movie, movieCmpFn);
+
+  const int *offsets = (const int *) movieFile + 1;
+  unsigned long long prefix = titlePrefix(movie.title.c_str());
+  int numNodes = movieTree.size();
+  int k = 1;
+  while (k < numNodes) {
+    const movieTreeNode& node = movieTree[k];
+    bool less = node.prefix != prefix ? node.prefix < prefix : 
+      compareFilmToRecord(movie, recordAt(movieFile, offsets[node.position])) > 0;
+    k = 2 * k + less;
   }
+  
+  // undo the right turns taken after the last left turn; that left turn's
+  // node is the first movie not less than the key (or k is 0 if there was none)
+  k >>= __builtin_ffs(~k);
+  if (k == 0) return NULL;
+  const int *entry = offsets + movieTree[k].position;
+  return compareFilmToRecord(movie, recordAt(movieFile, *entry)) == 0 ? entry : NULL;
 }
 
 /*
@@ -177,24 +486,12 @@ int movieCmpFn(const void *keyPtr, const void *elem)
  */
 void imdb::extractCast(const void *elem, vector<string>& players) const
 {
-  // first traverse the record to find the number of actors and start of the
-  // actor record offset values 
-  char *iter = (char *) elem;
-  while (*iter)
-    iter++;
-  iter += 2; // the \0 and the one-byte year offset
-  iter += (iter - (char *) elem) % 2; // padding in case the offset is odd
-
-  short *numActors = (short *) iter;
-  int *actorOffsets = (int *) (numActors + 1);
-  // need to move the pointer over two bytes if it is not a multiple of four
-  int additionalPadding = ((char *) actorOffsets - (char *) elem) % 4;
-  actorOffsets = (int *) ((char *) actorOffsets + additionalPadding);
+  int numActors;
+  const int *actorOffsets = movieActorOffsets(elem, numActors);
 
   players.clear(); 
-  for (int i = 0; i < *numActors; i++) {
-    char *actorName = (char *) actorFile + actorOffsets[i];
-    players.push_back(actorName);
+  for (int i = 0; i < numActors; i++) {
+    players.push_back(recordAt(actorFile, actorOffsets[i]));
   }
 }
 
@@ -205,31 +502,599 @@ void imdb::extractCast(const void *elem, vector<string>& players) const
  */
 bool imdb::getCast(const film& movie, vector<string>& players) const 
 { 
-  void *found = searchFile(movieFile, &movie, movieCmpFn);
+  const void *found = findMovieEntry(movie);
 
   if (found) {
-    extractCast(getRecord(movieFile, found), players);
+    extractCast(recordAt(movieFile, * (const int *) found), players);
     return true;
   } else { 
     return false;
   }
 }
 
+/*
+ * Converts the address of an entry in a data file's array of record
+ * offsets (as returned by searchFile) into an id: the offset itself,
+ * or its position in the array when the adjacency index is loaded.
+ */
+static int offsetEntryToId(const void *file, const void *entry, bool dense)
+{
+  if (entry == NULL) return imdb::kNoSuchId;
+  return dense ? (const int *) entry - ((const int *) file + 1) : * (const int *) entry;
+}
+
+bool imdb::visitCredits(const string& player, creditVisitor visitor, void *auxData) const
+{
+  const void *found = findActorEntry(player);
+  if (found == NULL) return false;
+
+  int numCredits;
+  const int *movieOffsets = actorMovieOffsets(recordAt(actorFile, * (const int *) found), numCredits);
+  for (int i = 0; i < numCredits; i++)
+    visitor(movieRecToFilmRef(recordAt(movieFile, movieOffsets[i])), auxData);
+  return true;
+}
+
+bool imdb::visitCast(const film& movie, castVisitor visitor, void *auxData) const
+{
+  const void *found = findMovieEntry(movie);
+  if (found == NULL) return false;
+
+  int numActors;
+  const int *actorOffsets = movieActorOffsets(recordAt(movieFile, * (const int *) found), numActors);
+  for (int i = 0; i < numActors; i++) {
+    const char *player = recordAt(actorFile, actorOffsets[i]);
+    visitor(player, strlen(player), auxData);
+  }
+  return true;
+}
+
+int imdb::getActorId(const string& player) const
+{
+  const void *found = findActorEntry(player);
+  return offsetEntryToId(actorFile, found, useAdjacencyIndex);
+}
+
+int imdb::getMovieId(const film& movie) const
+{
+  const void *found = findMovieEntry(movie);
+  return offsetEntryToId(movieFile, found, useAdjacencyIndex);
+}
+
+/*
+ * Ids are record offsets, so the arrays of offsets embedded in each
+ * record already are the arrays of neighboring ids.  With the adjacency
+ * index loaded, each id instead names a row of one of its tables.
+ */
+int imdb::getCreditIds(int actorId, const int *& movieIds) const
+{
+  if (useAdjacencyIndex) {
+    movieIds = actorTable.neighbors + actorTable.rowStarts[actorId];
+    return actorTable.rowStarts[actorId + 1] - actorTable.rowStarts[actorId];
+  }
+  
+  int numCredits;
+  movieIds = actorMovieOffsets(recordAt(actorFile, actorId), numCredits);
+  return numCredits;
+}
+
+int imdb::getCastIds(int movieId, const int *& actorIds) const
+{
+  if (useAdjacencyIndex) {
+    actorIds = movieTable.neighbors + movieTable.rowStarts[movieId];
+    return movieTable.rowStarts[movieId + 1] - movieTable.rowStarts[movieId];
+  }
+
+  int numActors;
+  actorIds = movieActorOffsets(recordAt(movieFile, movieId), numActors);
+  return numActors;
+}
+
+/*
+ * Returns the offset of the record for the identified actor or movie.
+ */
+static int idToOffset(const void *file, int id, bool dense)
+{
+  return dense ? ((const int *) file)[id + 1] : id;
+}
+
+string imdb::getActorName(int actorId) const
+{
+  int offset = idToOffset(actorFile, actorId, useAdjacencyIndex);
+  return recordAt(actorFile, offset);
+}
+
+film imdb::getFilm(int movieId) const
+{
+  int offset = idToOffset(movieFile, movieId, useAdjacencyIndex);
+  return movieRecToFilm(recordAt(movieFile, offset));
+}
+
+int imdb::decodeMovieYear(int movieId) const
+{
+  int offset = idToOffset(movieFile, movieId, useAdjacencyIndex);
+  return 1900 + *movieYearOffset(recordAt(movieFile, offset));
+}
+
+/*
+ * Fills in the year table from the year byte of every movie record.
+ * Slots that don't correspond to a movie (most of them, when ids are
+ * offsets) are left at zero.
+ */
+void imdb::buildYearTable()
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  movieYears.assign(getMovieIdLimit(), 0);
+  for (int i = 0; i < getNumMovies(); i++) {
+    int movieId = getMovieIdAt(i);
+    int offset = idToOffset(movieFile, movieId, useAdjacencyIndex);
+    movieYears[movieId] = *movieYearOffset(recordAt(movieFile, offset));
+  }
+  loadStep step = { "build the movie year table", millisecondsSince(start), true };
+  loadSteps.push_back(step);
+}
+
+int imdb::getActorIdLimit() const
+{
+  return useAdjacencyIndex ? getNumActors() : actorInfo.fileSize;
+}
+
+int imdb::getMovieIdLimit() const
+{
+  return useAdjacencyIndex ? getNumMovies() : movieInfo.fileSize;
+}
+
+int imdb::getActorIdAt(int index) const
+{
+  return useAdjacencyIndex ? index : ((const int *) actorFile)[index + 1];
+}
+
+int imdb::getMovieIdAt(int index) const
+{
+  return useAdjacencyIndex ? index : ((const int *) movieFile)[index + 1];
+}
+
+int imdb::getActorPosition(int actorId) const
+{
+  if (useAdjacencyIndex) return actorId;
+  const int *entry = (const int *) findActorEntry(recordAt(actorFile, actorId));
+  return entry - ((const int *) actorFile + 1);
+}
+
+/*
+ * Returns the position of the specified record offset within the sorted
+ * list of (offset, position) pairs.
+ */
+static int offsetToIndex(const vector<pair<int, int> >& offsetIndex, int offset)
+{
+  return lower_bound(offsetIndex.begin(), offsetIndex.end(), 
+		     make_pair(offset, 0))->second;
+}
+
+/*
+ * Pairs every record offset in the data file with the record's position in
+ * the file's offset array, sorted by offset so offsetToIndex can look them up.
+ */
+static void buildOffsetIndex(const void *file, vector<pair<int, int> >& offsetIndex)
+{
+  int numRecords = * (const int *) file;
+  const int *offsets = (const int *) file + 1;
+  offsetIndex.resize(numRecords);
+  for (int i = 0; i < numRecords; i++)
+    offsetIndex[i] = make_pair(offsets[i], i);
+  sort(offsetIndex.begin(), offsetIndex.end());
+}
+
+/*
+ * Writes the specified ints to the file, returning false on failure.
+ */
+static bool writeInts(FILE *outfile, const int *ints, size_t numInts)
+{
+  return fwrite(ints, sizeof(int), numInts, outfile) == numInts;
+}
+
+bool imdb::buildAdjacencyIndex(const string& directory)
+{
+  imdb db(directory);
+  if (!db.good()) return false;
+
+  vector<pair<int, int> > actorIndex, movieIndex;
+  buildOffsetIndex(db.actorFile, actorIndex);
+  buildOffsetIndex(db.movieFile, movieIndex);
+
+  adjacencyHeader header;
+  header.magic = kAdjacencyMagic;
+  header.numActors = db.getNumActors();
+  header.numMovies = db.getNumMovies();
+  header.actorFileSize = db.actorInfo.fileSize;
+  header.movieFileSize = db.movieInfo.fileSize;
+  
+  vector<int> actorRowStarts(1, 0), actorNeighbors;
+  for (int i = 0; i < header.numActors; i++) {
+    const int *movieIds;
+    int numCredits = db.getCreditIds(db.getActorIdAt(i), movieIds);
+    for (int j = 0; j < numCredits; j++)
+      actorNeighbors.push_back(offsetToIndex(movieIndex, movieIds[j]));
+    actorRowStarts.push_back(actorNeighbors.size());
+  }
+
+  vector<int> movieRowStarts(1, 0), movieNeighbors;
+  for (int i = 0; i < header.numMovies; i++) {
+    const int *actorIds;
+    int numActors = db.getCastIds(db.getMovieIdAt(i), actorIds);
+    for (int j = 0; j < numActors; j++)
+      movieNeighbors.push_back(offsetToIndex(actorIndex, actorIds[j]));
+    movieRowStarts.push_back(movieNeighbors.size());
+  }
+
+  // the two tables needn't list the same number of credits, but the
+  // loader sizes the first neighbors array from this count.
+  header.numCredits = actorNeighbors.size();
+
+  const string fileName = directory + "/" + kAdjacencyFileName;
+  FILE *outfile = fopen(fileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool written = 
+    fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+    writeInts(outfile, &actorRowStarts[0], actorRowStarts.size()) &&
+    writeInts(outfile, &actorNeighbors[0], actorNeighbors.size()) &&
+    writeInts(outfile, &movieRowStarts[0], movieRowStarts.size()) &&
+    writeInts(outfile, &movieNeighbors[0], movieNeighbors.size());
+  if (fclose(outfile) != 0) written = false;
+  if (!written) remove(fileName.c_str());
+  return written;
+}
+
+bool imdb::buildNameIndex(const string& directory)
+{
+  imdb db(directory);
+  if (!db.good()) return false;
+
+  nameIndexHeader header;
+  header.magic = kNameIndexMagic;
+  header.numActors = db.getNumActors();
+  header.actorFileSize = db.actorInfo.fileSize;
+  // keep the table at most half full, so probe sequences stay short
+  header.numSlots = 1;
+  while (header.numSlots < 2 * header.numActors) header.numSlots *= 2;
+
+  nameSlot empty = { 0, -1 };
+  vector<nameSlot> slots(header.numSlots, empty);
+  const int *offsets = (const int *) db.actorFile + 1;
+  for (int position = 0; position < header.numActors; position++) {
+    unsigned int hash = hashName(db.recordAt(db.actorFile, offsets[position]));
+    unsigned int i = hash & (header.numSlots - 1);
+    while (slots[i].position != -1) i = (i + 1) & (header.numSlots - 1);
+    slots[i].hash = hash;
+    slots[i].position = position;
+  }
+
+  const string fileName = directory + "/" + kNameIndexFileName;
+  FILE *outfile = fopen(fileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool written = 
+    fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+    fwrite(&slots[0], sizeof(nameSlot), slots.size(), outfile) == slots.size();
+  if (fclose(outfile) != 0) written = false;
+  if (!written) remove(fileName.c_str());
+  return written;
+}
+
+/*
+ * Maps the adjacency index and points the two tables into it, provided it
+ * exists and was built from the data files currently mapped.  Returns
+ * true if and only if the index is ready for use.
+ */
+bool imdb::loadAdjacencyIndex(const string& fileName)
+{
+  if (actorInfo.fd == -1 || movieInfo.fd == -1) return false;
+  const void *index = acquireFileMap(fileName, adjacencyInfo);
+  if (adjacencyInfo.fd == -1 || index == MAP_FAILED) {
+    adjacencyInfo.fileMap = NULL;
+    return false;
+  }
+  
+  const adjacencyHeader *header = (const adjacencyHeader *) index;
+  if (adjacencyInfo.fileSize < sizeof(adjacencyHeader) ||
+      header->magic != kAdjacencyMagic ||
+      header->numActors != getNumActors() || 
+      header->numMovies != getNumMovies() ||
+      header->actorFileSize != (int) actorInfo.fileSize ||
+      header->movieFileSize != (int) movieInfo.fileSize) return false;
+  
+  size_t numLeadingInts = (header->numActors + 1) + header->numCredits + (header->numMovies + 1);
+  if (adjacencyInfo.fileSize < sizeof(adjacencyHeader) + numLeadingInts * sizeof(int)) return false;
+  
+  actorTable.rowStarts = (const int *) (header + 1);
+  actorTable.neighbors = actorTable.rowStarts + header->numActors + 1;
+  movieTable.rowStarts = actorTable.neighbors + header->numCredits;
+  movieTable.neighbors = movieTable.rowStarts + header->numMovies + 1;
+  size_t numInts = numLeadingInts + movieTable.rowStarts[header->numMovies];
+  return adjacencyInfo.fileSize == sizeof(adjacencyHeader) + numInts * sizeof(int);
+}
+
+/*
+ * Maps the name index, provided it exists and was built from the actor
+ * file currently mapped.  Returns true if and only if the index is ready
+ * for use.
+ */
+bool imdb::loadNameIndex(const string& fileName)
+{
+  if (actorInfo.fd == -1) return false;
+  const void *index = acquireFileMap(fileName, nameIndexInfo);
+  if (nameIndexInfo.fd == -1 || index == MAP_FAILED) {
+    nameIndexInfo.fileMap = NULL;
+    return false;
+  }
+
+  const nameIndexHeader *header = (const nameIndexHeader *) index;
+  if (nameIndexInfo.fileSize < sizeof(nameIndexHeader) ||
+      header->magic != kNameIndexMagic ||
+      header->numActors != getNumActors() ||
+      header->actorFileSize != (int) actorInfo.fileSize ||
+      header->numSlots <= header->numActors ||
+      (header->numSlots & (header->numSlots - 1)) != 0 ||
+      nameIndexInfo.fileSize != sizeof(nameIndexHeader) + header->numSlots * sizeof(nameSlot)) 
+    return false;
+
+  nameSlots = (const nameSlot *) (header + 1);
+  nameSlotMask = header->numSlots - 1;
+  return true;
+}
+
 imdb::~imdb()
 {
   releaseFileMap(actorInfo);
   releaseFileMap(movieInfo);
+  releaseFileMap(adjacencyInfo);
+  releaseFileMap(nameIndexInfo);
+  if (actorCache == NULL && movieCache == NULL) return;
+  delete actorCache;
+  delete movieCache;
+  // other threads' buffers are freed as they exit
+  releaseScratch(pthread_getspecific(scratchKey));
+  pthread_key_delete(scratchKey);
+}
+
+bool imdb::getCacheStats(cacheStats& actors, cacheStats& movies) const
+{
+  if (actorCache == NULL && movieCache == NULL) return false;
+  actors = actorCache == NULL ? cacheStats() : actorCache->getStats();
+  movies = movieCache == NULL ? cacheStats() : movieCache->getStats();
+  return true;
+}
+
+/*
+ * Creates a block cache for each data file acquireCachedDataFile left
+ * unmapped, sharing the budget between them by size, so that each gets
+ * about the same fraction of its file.
+ */
+void imdb::createBlockCaches()
+{
+  size_t actorBytes = actorInfo.fd != -1 && actorInfo.fileMap == NULL ? actorInfo.fileSize : 0;
+  size_t movieBytes = movieInfo.fd != -1 && movieInfo.fileMap == NULL ? movieInfo.fileSize : 0;
+  if (actorBytes + movieBytes == 0) return;
+  size_t actorBudget = (double) requested.cacheBudget * actorBytes / (actorBytes + movieBytes);
+  if (actorBytes != 0) 
+    actorCache = new blockCache(actorInfo.fd, actorBytes, actorBudget, requested.cacheBlockSize);
+  if (movieBytes != 0)
+    movieCache = new blockCache(movieInfo.fd, movieBytes, requested.cacheBudget - actorBudget,
+				requested.cacheBlockSize);
+  pthread_key_create(&scratchKey, releaseScratch);
+}
+
+/*
+ * The data files come in two byte orders, depending on the machine that
+ * wrote them, and the record code reads their ints and shorts in place.
+ * A file's order is detected from its header: read in the right order,
+ * the record count must leave room for the offset array, and the first
+ * and last offsets must land past that array and inside the file.
+ */
+enum byteOrder { kNativeOrder, kSwappedOrder, kUnknownOrder };
+
+static bool plausibleHeader(const void *file, size_t fileSize, bool swapped)
+{
+  if (fileSize < sizeof(int)) return false;
+  const int *ints = (const int *) file;
+  int numRecords = swapped ? __builtin_bswap32(ints[0]) : ints[0];
+  if (numRecords < 0 || (1 + (size_t) numRecords) * sizeof(int) > fileSize) return false;
+  if (numRecords == 0) return true;
+  size_t recordsStart = (1 + (size_t) numRecords) * sizeof(int);
+  int first = swapped ? __builtin_bswap32(ints[1]) : ints[1];
+  int last = swapped ? __builtin_bswap32(ints[numRecords]) : ints[numRecords];
+  return first >= 0 && (size_t) first >= recordsStart && (size_t) first < fileSize &&
+         last >= 0 && (size_t) last >= recordsStart && (size_t) last < fileSize;
+}
+
+static byteOrder detectByteOrder(const void *file, size_t fileSize)
+{
+  if (plausibleHeader(file, fileSize, false)) return kNativeOrder;
+  if (plausibleHeader(file, fileSize, true)) return kSwappedOrder;
+  return kUnknownOrder;
+}
+
+/*
+ * Byte-swaps every int and short in an actor or movie file in place:
+ * the record count, the offsets, and each record's count and offsets.
+ * The record layouts are the ones actorMovieOffsets and movieActorOffsets
+ * read.  Returns false if some record runs past the end of the file.
+ */
+static bool swapDataFile(char *file, size_t fileSize, bool isMovieFile)
+{
+  int *offsets = (int *) file;
+  int numRecords = offsets[0] = __builtin_bswap32(offsets[0]);
+  for (int i = 1; i <= numRecords; i++) {
+    int offset = offsets[i] = __builtin_bswap32(offsets[i]);
+    if (offset < 0 || (size_t) offset >= fileSize) return false;
+    char *record = file + offset;
+    char *nameEnd = (char *) memchr(record, '\0', fileSize - offset);
+    if (nameEnd == NULL) return false;
+    size_t size = nameEnd + 1 - record + (isMovieFile ? 1 : 0); // the movie's year byte
+    size += size % 2;
+    if (offset + size + sizeof(short) > fileSize) return false;
+    short *countPtr = (short *) (record + size);
+    short count = *countPtr = __builtin_bswap16(*countPtr);
+    size += sizeof(short);
+    size += size % 4;
+    if (count < 0 || offset + size + count * sizeof(int) > fileSize) return false;
+    int *references = (int *) (record + size);
+    for (int j = 0; j < count; j++) references[j] = __builtin_bswap32(references[j]);
+  }
+  return true;
+}
+
+/*
+ * Writes the converted file out under a temporary name and then renames
+ * it into place, so other processes never map a half-written cache.
+ */
+static bool writeNativeCache(const string& cacheName, const char *file, size_t fileSize)
+{
+  char suffix[32];
+  sprintf(suffix, ".%d", (int) getpid());
+  const string tempName = cacheName + suffix;
+  FILE *outfile = fopen(tempName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool written = fwrite(file, 1, fileSize, outfile) == fileSize;
+  if (fclose(outfile) != 0) written = false;
+  if (written) written = rename(tempName.c_str(), cacheName.c_str()) == 0;
+  if (!written) remove(tempName.c_str());
+  return written;
+}
+
+/*
+ * Maps the named actor or movie file, and if it's in the other byte order,
+ * swaps in its native-order cache instead.  The cache sits beside the file,
+ * named for this machine's byte order, and is trusted as long as it's the
+ * same size and no older.  Otherwise the file is mapped privately, swapped
+ * in place (copying only the pages touched), and written out as the cache
+ * for next time.  If the cache can't be written, as when the data directory
+ * is read-only, the private copy is used as is.
+ */
+const void *imdb::acquireDataFile(const string& fileName, struct fileInfo& info, bool isMovieFile)
+{
+  const void *file = acquireFileMap(fileName, info);
+  if (info.fd == -1 || file == MAP_FAILED || 
+      detectByteOrder(file, info.fileSize) != kSwappedOrder) return file;
+
+  const string cacheName = fileName + kNativeCacheSuffix;
+  struct stat fileStats, cacheStats;
+  fstat(info.fd, &fileStats);
+  if (stat(cacheName.c_str(), &cacheStats) == 0 && cacheStats.st_size == fileStats.st_size &&
+      cacheStats.st_mtime >= fileStats.st_mtime) {
+    struct fileInfo cacheInfo;
+    const void *cache = acquireFileMap(cacheName, cacheInfo);
+    if (cacheInfo.fd != -1 && cache != MAP_FAILED && 
+	detectByteOrder(cache, cacheInfo.fileSize) == kNativeOrder) {
+      releaseFileMap(info);
+      info = cacheInfo;
+      return cache;
+    }
+    if (cache == MAP_FAILED) cacheInfo.fileMap = NULL;
+    releaseFileMap(cacheInfo);
+  }
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  munmap((char *) info.fileMap, info.fileSize);
+  void *converted = mmap(0, info.fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, info.fd, 0);
+  bool swapped = converted != MAP_FAILED && swapDataFile((char *) converted, info.fileSize, isMovieFile);
+  loadStep step = { "convert " + fileName + " to native byte order", millisecondsSince(start), swapped };
+  loadSteps.push_back(step);
+  if (!swapped) {
+    if (converted != MAP_FAILED) munmap(converted, info.fileSize);
+    close(info.fd);
+    info.fd = -1;
+    info.fileMap = NULL;
+    return MAP_FAILED;
+  }
+  info.fileMap = converted;
+  info.privateCopy = true;
+
+  gettimeofday(&start, NULL);
+  bool cached = writeNativeCache(cacheName, (const char *) converted, info.fileSize);
+  loadStep cacheStep = { "write " + cacheName, millisecondsSince(start), cached };
+  loadSteps.push_back(cacheStep);
+  if (cached) {
+    struct fileInfo cacheInfo;
+    const void *cache = acquireFileMap(cacheName, cacheInfo);
+    if (cacheInfo.fd != -1 && cache != MAP_FAILED) {
+      releaseFileMap(info);
+      info = cacheInfo;
+      return cache;
+    }
+    if (cache == MAP_FAILED) cacheInfo.fileMap = NULL;
+    releaseFileMap(cacheInfo);
+  }
+  return converted;
+}
+
+/*
+ * Acquires the named actor or movie file as acquireDataFile does, then
+ * copies its record count and offset array into header, which stands in
+ * for the file from then on, and unmaps the rest, keeping the file open
+ * for a block cache to read the records from.  A private copy (one in the
+ * other byte order whose native-order cache couldn't be written) or a file
+ * whose header doesn't make sense stays mapped as it is.
+ */
+const void *imdb::acquireCachedDataFile(const string& fileName, struct fileInfo& info,
+					bool isMovieFile, vector<int>& header)
+{
+  const void *file = acquireDataFile(fileName, info, isMovieFile);
+  if (info.fd == -1 || file == MAP_FAILED || info.privateCopy ||
+      detectByteOrder(file, info.fileSize) != kNativeOrder) return file;
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  const int *ints = (const int *) file;
+  header.assign(ints, ints + 1 + ints[0]);
+  munmap((char *) info.fileMap, info.fileSize);
+  info.fileMap = NULL;
+  loadStep step = { "copy the offsets out of " + fileName, millisecondsSince(start), true };
+  loadSteps.push_back(step);
+  return &header[0];
 }
 
 // ignore everything below... it's all UNIXy stuff in place to make a file look like
 // an array of bytes in RAM.. 
 const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info)
 {
+  struct timeval start;
+  gettimeofday(&start, NULL);
   struct stat stats;
   stat(fileName.c_str(), &stats);
   info.fileSize = stats.st_size;
   info.fd = open(fileName.c_str(), O_RDONLY);
-  return info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
+  info.privateCopy = false;
+  int flags = MAP_SHARED;
+  string description = "map " + fileName;
+#ifdef MAP_POPULATE
+  if (requested.prefault) {
+    flags |= MAP_POPULATE;
+    description += " with MAP_POPULATE";
+  }
+#endif
+  info.fileMap = mmap(0, info.fileSize, PROT_READ, flags, info.fd, 0);
+  loadStep step = { description, millisecondsSince(start), info.fileMap != MAP_FAILED };
+  loadSteps.push_back(step);
+  if (info.fileMap == MAP_FAILED) return info.fileMap;
+
+  if (requested.willNeed) adviseFileMap(fileName, info, MADV_WILLNEED, "MADV_WILLNEED");
+  if (requested.randomAccess) adviseFileMap(fileName, info, MADV_RANDOM, "MADV_RANDOM");
+#ifdef MADV_HUGEPAGE
+  if (requested.hugePages) adviseFileMap(fileName, info, MADV_HUGEPAGE, "MADV_HUGEPAGE");
+#endif
+  return info.fileMap;
+}
+
+void imdb::adviseFileMap(const string& fileName, const struct fileInfo& info,
+			 int advice, const char *adviceName)
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  bool succeeded = madvise((void *) info.fileMap, info.fileSize, advice) == 0;
+  loadStep step = { string(adviceName) + " " + fileName, millisecondsSince(start), succeeded };
+  loadSteps.push_back(step);
 }
 
 void imdb::releaseFileMap(struct fileInfo& info)
@@ -2,10 +2,117 @@
 #define __imdb__
 
 #include "imdb-utils.h"
+#include "block-cache.h"
+#include <pthread.h>
 #include <string>
 #include <vector>
 using namespace std;
 
+/**
+ * Convenience struct: imdbOptions
+ * -------------------------------
+ * Selects how an imdb goes about loading and accessing its data.
+ * The defaults reproduce the original behavior: both data files are
+ * mapped into memory and nothing else is loaded.
+ *
+ *     useAdjacencyIndex: also map the adjacency index built by imdb-index
+ *                        (see imdb::buildAdjacencyIndex), and identify actors
+ *                        and movies by dense ids drawn from it.
+ *     useNameIndex:      also map the actor name index built by imdb-index
+ *                        (see imdb::buildNameIndex), and use it to look up
+ *                        actors and actresses by name.
+ *     useMovieTree:      lay the movies out in an Eytzinger-ordered search
+ *                        tree as the imdb is constructed, and use it to look
+ *                        up films.  Costs 16 bytes of memory per movie.
+ *     useYearTable:      copy every movie's year into a flat array indexed
+ *                        by movie id as the imdb is constructed, so
+ *                        getMovieYear needn't decode records.  Costs a byte
+ *                        per possible movie id.
+ *
+ * The remaining options control how every file is mapped, trading startup
+ * time for first-query latency.  Each is only a request to the kernel:
+ *
+ *     prefault:          map with MAP_POPULATE, so every page is read in
+ *                        before the constructor returns.
+ *     willNeed:          advise MADV_WILLNEED, which starts reading every
+ *                        page in the background.
+ *     randomAccess:      advise MADV_RANDOM, which turns off readahead; best
+ *                        for lookup-heavy workloads that touch scattered records.
+ *     hugePages:         advise MADV_HUGEPAGE, which backs the mappings with
+ *                        transparent huge pages where the kernel supports it
+ *                        for files, cutting TLB misses.
+ *
+ * Rather than mapping the actor and movie files whole, an imdb can read
+ * their records through a block cache of bounded size (see block-cache.h),
+ * so the data never occupies more than a fixed amount of memory:
+ *
+ *     cacheBudget:       when nonzero, the number of bytes of blocks to cache,
+ *                        split between the two files in proportion to their
+ *                        sizes.  Only each file's offset array is kept in
+ *                        memory besides.  The indices are still mapped.
+ *     cacheBlockSize:    the number of bytes read from a file at a time.
+ */
+
+struct imdbOptions {
+  bool useAdjacencyIndex;
+  bool useNameIndex;
+  bool useMovieTree;
+  bool useYearTable;
+  bool prefault;
+  bool willNeed;
+  bool randomAccess;
+  bool hugePages;
+  size_t cacheBudget;
+  int cacheBlockSize;
+  imdbOptions() : useAdjacencyIndex(false), useNameIndex(false), useMovieTree(false),
+    useYearTable(false), prefault(false), willNeed(false), randomAccess(false), hugePages(false),
+    cacheBudget(0), cacheBlockSize(blockCache::kDefaultBlockSize) {}
+};
+
+/**
+ * Convenience struct: loadStep
+ * ----------------------------
+ * One step an imdb took while loading (mapping a file, or advising the
+ * kernel about a mapping), along with how long it took and whether it
+ * succeeded.
+ */
+
+struct loadStep {
+  string description;
+  double milliseconds;
+  bool succeeded;
+};
+
+/**
+ * Convenience struct: filmRef
+ * ---------------------------
+ * Describes a film without copying it out of the imdb: title addresses
+ * the first of titleLength characters (followed by a '\0') inside the
+ * imdb's own memory, and stays valid for as long as the imdb does (or,
+ * when the imdb reads through a block cache, until the thread that got
+ * it reads another movie).
+ */
+
+struct filmRef {
+  const char *title;
+  int titleLength;
+  int year;
+};
+
+/**
+ * Function types: creditVisitor
+ *                 castVisitor
+ * -----------------------------
+ * Callbacks handed to imdb::visitCredits and imdb::visitCast.  Each is
+ * called once per film (or per actor/actress, whose name is player[0]
+ * through player[length - 1]) along with the client's auxData pointer.
+ * When the imdb reads through a block cache, player is only valid for
+ * the duration of the call.
+ */
+
+typedef void (*creditVisitor)(const filmRef& movie, void *auxData);
+typedef void (*castVisitor)(const char *player, int length, void *auxData);
+
 class imdb {
   
  public:
@@ -13,6 +120,7 @@ class imdb {
   void extractCast(const void *elem, vector<string>& players) const;
   void *searchFile(const void *file, const void *key,
     int (*cmpFn)(const void *, const void *)) const;
+  const char *recordAt(const void *file, int offset) const;
   
   /**
    * Constructor: imdb
@@ -23,10 +131,16 @@ class imdb {
    * all of the information about the movies and actors relevant to an IMDB
    * application (like six-degrees).
    *
+   * The files may be in either byte order.  Files in the other order are
+   * converted once into native-order caches beside them (named for this
+   * machine's order, as in actordata.little-endian), which are mapped in
+   * their place from then on.
+   *
    * @param directory the name of the directory housing the formatted information backing the imdb.
+   * @param options selects optional load modes; see imdbOptions above.
    */
 
-  imdb(const string& directory);
+  imdb(const string& directory, const imdbOptions& options = imdbOptions());
 
   /**
    * Predicate Method: good
@@ -37,6 +151,8 @@ class imdb {
    *     1.) either one or both of the data files supporting the imdb were missing
    *     2.) the directory passed to the constructor doesn't exist.
    *     3.) the directory and files all exist, but you don't have the permission to read them.
+   *     4.) the adjacency index or the name index was requested, but it's missing or out of date.
+   *     5.) the data files are in the other byte order, and some record runs past the end.
    */
 
   bool good() const;
@@ -78,6 +194,186 @@ class imdb {
 
   bool getCast(const film& movie, vector<string>& players) const;
 
+  /**
+   * Methods: visitCredits
+   *          visitCast
+   * ---------------------
+   * Allocation-free versions of getCredits and getCast: rather than copying
+   * every film or name into a vector, they call the visitor once for each
+   * film (or actor/actress) in turn, in the same order getCredits and getCast
+   * would list them, passing pointers straight into the imdb's memory.
+   *
+   * @param visitor the function to call on each film or actor/actress.
+   * @param auxData passed through to every call to visitor.
+   * @return true if and only if the specified actor/actress (or movie) appeared
+   *              in the database, and false otherwise.
+   */
+
+  bool visitCredits(const string& player, creditVisitor visitor, void *auxData) const;
+  bool visitCast(const film& movie, castVisitor visitor, void *auxData) const;
+
+  /**
+   * Node ids
+   * --------
+   * The methods below identify actors and movies by the 32-bit offsets of
+   * their records within the actor and movie files or, when the adjacency
+   * index is loaded, by their positions in the sorted actor and movie lists.
+   * Either way, ids are stable for the lifetime of the imdb, are always
+   * nonnegative, and are bounded above by getActorIdLimit() and
+   * getMovieIdLimit(), so clients can index flat arrays and bitmaps by
+   * them.  Searches that only need to follow connections can work entirely
+   * in terms of ids and convert back to names and films once they're done.
+   */
+
+  static const int kNoSuchId = -1;
+
+  /**
+   * Methods: getActorId
+   *          getMovieId
+   * --------------------
+   * Returns the id of the specified actor/actress or film, or kNoSuchId if
+   * it isn't in the database.
+   */
+
+  int getActorId(const string& player) const;
+  int getMovieId(const film& movie) const;
+
+  /**
+   * Methods: getCreditIds
+   *          getCastIds
+   * ---------------------
+   * Sets ids to address the ids of the films the identified actor/actress appeared
+   * in (or of the actors and actresses starring in the identified film) and returns
+   * how many there are.  The ids live inside the imdb's own memory, so nothing
+   * is copied, and the addresses remain valid for as long as the imdb does.
+   * The exception is an imdb that reads through a block cache without the
+   * adjacency index: there the ids are read into a buffer the calling thread
+   * reuses, so they're only valid until it next reads the same file (by
+   * calling getCreditIds again, say, or getActorName).
+   */
+
+  int getCreditIds(int actorId, const int *& movieIds) const;
+  int getCastIds(int movieId, const int *& actorIds) const;
+
+  /**
+   * Methods: getActorName
+   *          getFilm
+   * -----------------
+   * Converts an actor/actress or movie id back into a name or a film.
+   */
+
+  string getActorName(int actorId) const;
+  film getFilm(int movieId) const;
+
+  /**
+   * Method: getMovieYear
+   * --------------------
+   * Returns the year the identified movie was released, read from the
+   * year table when the imdb has one and from the movie's record otherwise.
+   */
+
+  int getMovieYear(int movieId) const {
+    return movieYears.empty() ? decodeMovieYear(movieId) : 1900 + movieYears[movieId];
+  }
+
+  /**
+   * Methods: getActorIdLimit
+   *          getMovieIdLimit
+   * ------------------------
+   * Returns a number strictly greater than every actor (or movie) id.
+   */
+
+  int getActorIdLimit() const;
+  int getMovieIdLimit() const;
+
+  /**
+   * Predicate Method: hasDenseIds
+   * -----------------------------
+   * Returns true if and only if ids are positions in the sorted actor and
+   * movie lists (as they are whenever the adjacency index is loaded), in
+   * which case the id limits are just the numbers of actors and movies.
+   */
+
+  bool hasDenseIds() const { return useAdjacencyIndex; }
+
+  /**
+   * Methods: getNumActors
+   *          getNumMovies
+   *          getActorIdAt
+   *          getMovieIdAt
+   * ---------------------
+   * Enumerate every actor/actress and every movie in the database.  Position
+   * 0 holds the alphabetically first name (or film), position 1 the next,
+   * and so forth.
+   */
+
+  int getNumActors() const { return * (int *) actorFile; }
+  int getNumMovies() const { return * (int *) movieFile; }
+  int getActorIdAt(int index) const;
+  int getMovieIdAt(int index) const;
+
+  /**
+   * Method: getActorPosition
+   * ------------------------
+   * The inverse of getActorIdAt: returns the position of the identified
+   * actor/actress in the alphabetical enumeration.
+   */
+
+  int getActorPosition(int actorId) const;
+
+  /**
+   * Static Method: buildAdjacencyIndex
+   * ----------------------------------
+   * Precomputes the actor/movie graph stored in the specified directory as a
+   * pair of compressed sparse rows, one listing each actor's movies and one
+   * listing each movie's actors, and writes them to the adjacency index
+   * file in that same directory.  An imdb constructed with useAdjacencyIndex
+   * set maps that file and answers getCreditIds and getCastIds by indexing
+   * straight into it instead of walking variable-length records.
+   *
+   * @param directory the directory housing the data files and the index.
+   * @return true if and only if the index was written successfully.
+   */
+
+  static bool buildAdjacencyIndex(const string& directory);
+
+  /**
+   * Static Method: buildNameIndex
+   * -----------------------------
+   * Hashes the name of every actor and actress in the specified directory
+   * into an open-addressing table and writes it to the name index file in
+   * that same directory.  An imdb constructed with useNameIndex set maps
+   * that file and resolves names by probing it, which typically touches
+   * one table slot and the one record it leads to, instead of binary
+   * searching the actor file and comparing against a record on every probe.
+   *
+   * @param directory the directory housing the data files and the index.
+   * @return true if and only if the index was written successfully.
+   */
+
+  static bool buildNameIndex(const string& directory);
+
+  /**
+   * Method: getLoadSteps
+   * --------------------
+   * Lists every step the constructor took, in order, so clients can see
+   * what each of the mapping options in imdbOptions cost at startup.
+   */
+
+  const vector<loadStep>& getLoadSteps() const { return loadSteps; }
+
+  /**
+   * Method: getCacheStats
+   * ---------------------
+   * Sets actors and movies to the counters of the block caches the actor
+   * and movie files are read through, so a cacheBudget can be sized by
+   * its hit rate.
+   *
+   * @return true if and only if the files are read through block caches.
+   */
+
+  bool getCacheStats(cacheStats& actors, cacheStats& movies) const;
+
   /**
    * Destructor: ~imdb
    * -----------------
@@ -90,19 +386,82 @@ class imdb {
  private:
   static const char *const kActorFileName;
   static const char *const kMovieFileName;
+  static const char *const kAdjacencyFileName;
+  static const char *const kNameIndexFileName;
+  static const char *const kNativeCacheSuffix;
   const void *actorFile;
   const void *movieFile;
+
+  // the adjacency index, when it's loaded: row i of a table lists the
+  // neighbors of the actor (or movie) with id i, and runs from entry
+  // rowStarts[i] to just before entry rowStarts[i + 1] of its neighbors array.
+  struct adjacencyTable {
+    const int *rowStarts;
+    const int *neighbors;
+  } actorTable, movieTable;
+  bool useAdjacencyIndex;
+
+  // the name index, when it's loaded: a power-of-two number of slots, each
+  // either empty or holding a name's hash and the position of its offset
+  // within the actor file's offset array.
+  struct nameSlot {
+    unsigned int hash;
+    int position;
+  };
+  const nameSlot *nameSlots;
+  unsigned int nameSlotMask;
+  bool useNameIndex;
+
+  imdbOptions requested;
+
+  // one node of the Eytzinger-ordered movie search tree: the first eight
+  // characters of the movie's title, packed by titlePrefix in imdb.cc, and
+  // the position of the movie's offset within the movie file's offset array.
+  struct movieTreeNode {
+    unsigned long long prefix;
+    int position;
+  };
+  vector<movieTreeNode> movieTree;
+  void buildMovieTree();
+  int layoutMovieTree(int position, int k);
+  const void *findMovieEntry(const film& movie) const;
+
+  // the year table, when it's built: each movie's year, less 1900, at its id
+  vector<unsigned char> movieYears;
+  void buildYearTable();
+  int decodeMovieYear(int movieId) const;
   
+  // the block caches, when the data files are read through them, along with
+  // the copies of the files' record counts and offset arrays that actorFile
+  // and movieFile then address, and the key to each thread's record buffers
+  blockCache *actorCache;
+  blockCache *movieCache;
+  vector<int> actorHeader, movieHeader;
+  pthread_key_t scratchKey;
+  void createBlockCaches();
+  const char *readRecord(blockCache *cache, bool isMovieFile, int offset) const;
+
   // everything below here is complicated and needn't be touched.
   // you're free to investigate, but you're on your own.
   struct fileInfo {
     int fd;
     size_t fileSize;
     const void *fileMap;
-  } actorInfo, movieInfo;
+    bool privateCopy;
+  } actorInfo, movieInfo, adjacencyInfo, nameIndexInfo;
+  
+  vector<loadStep> loadSteps;
   
-  static const void *acquireFileMap(const string& fileName, struct fileInfo& info);
+  const void *acquireFileMap(const string& fileName, struct fileInfo& info);
+  const void *acquireDataFile(const string& fileName, struct fileInfo& info, bool isMovieFile);
+  const void *acquireCachedDataFile(const string& fileName, struct fileInfo& info, bool isMovieFile,
+				    vector<int>& header);
+  void adviseFileMap(const string& fileName, const struct fileInfo& info, 
+		     int advice, const char *adviceName);
   static void releaseFileMap(struct fileInfo& info);
+  bool loadAdjacencyIndex(const string& fileName);
+  bool loadNameIndex(const string& fileName);
+  const void *findActorEntry(const string& player) const;
 
   // marked as private so imdbs can't be copy constructed or reassigned.
   // if we were to allow this, we'd alias open files and accidentally close
@@ -111,6 +470,9 @@ class imdb {
   imdb(const imdb& original);
   imdb& operator=(const imdb& rhs);
   imdb& operator=(const imdb& rhs) const;
+  // the benchmarks in imdb-bench.cc time extractFilms and extractCast on
+  // records they locate themselves
+  friend class imdbBenchmark;
 };
 
 #endif
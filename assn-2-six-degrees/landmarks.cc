@@ -0,0 +1,128 @@
+#include "landmarks.h"
+#include "search.h"
+#include <algorithm>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+const char *const landmarkOracle::kLandmarkFileName = "landmarks";
+
+/*
+ * The landmark file opens with a header identifying the data it was built
+ * from, follows it with the positions of the landmarks, and ends with
+ * every actor's distances from the landmarks, actor by actor, one byte
+ * per landmark (kUnreachable if the landmark can't reach the actor).
+ */
+struct landmarkHeader {
+  int magic;
+  int numLandmarks;
+  int numActors;
+};
+
+static const int kLandmarkMagic = 0x4c4d4b31; // "LMK1"
+
+landmarkOracle::landmarkOracle(const imdb& db, const string& directory) :
+  db(db), fileSize(0), fileMap(NULL), numLandmarks(0), distances(NULL)
+{
+  const string fileName = directory + "/" + kLandmarkFileName;
+  fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat stats;
+  if (fstat(fd, &stats) == -1) return;
+  fileSize = stats.st_size;
+  if (fileSize < sizeof(landmarkHeader)) return;
+  void *map = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) return;
+  fileMap = map;
+
+  const landmarkHeader *header = (const landmarkHeader *) fileMap;
+  if (header->magic != kLandmarkMagic || header->numActors != db.getNumActors() ||
+      fileSize != sizeof(landmarkHeader) + header->numLandmarks * sizeof(int) +
+                  (size_t) header->numActors * header->numLandmarks) return;
+  numLandmarks = header->numLandmarks;
+  distances = (const unsigned char *) ((const int *) (header + 1) + numLandmarks);
+}
+
+landmarkOracle::~landmarkOracle()
+{
+  if (fileMap != NULL) munmap((void *) fileMap, fileSize);
+  if (fd != -1) close(fd);
+}
+
+void landmarkOracle::getBounds(int sourceId, int targetId, int& lower, int& upper) const
+{
+  lower = 0;
+  upper = kInfinite;
+  if (sourceId == targetId) {
+    upper = 0;
+    return;
+  }
+  
+  const unsigned char *fromSource = distances + (size_t) db.getActorPosition(sourceId) * numLandmarks;
+  const unsigned char *fromTarget = distances + (size_t) db.getActorPosition(targetId) * numLandmarks;
+  for (int k = 0; k < numLandmarks; k++) {
+    int s = fromSource[k], t = fromTarget[k];
+    if (s == kUnreachable && t == kUnreachable) continue;
+    if (s == kUnreachable || t == kUnreachable) {
+      lower = upper = kInfinite;
+      return;
+    }
+    lower = max(lower, s > t ? s - t : t - s);
+    upper = min(upper, s + t);
+  }
+  lower = max(lower, 1);
+}
+
+/*
+ * Returns the positions of the numLandmarks actors with the most credits,
+ * breaking ties in favor of the earlier position.
+ */
+static vector<int> pickLandmarks(const imdb& db, int numLandmarks)
+{
+  vector<pair<int, int> > degrees(db.getNumActors());
+  for (int i = 0; i < (int) degrees.size(); i++) {
+    const int *movieIds;
+    degrees[i] = make_pair(-db.getCreditIds(db.getActorIdAt(i), movieIds), i);
+  }
+  numLandmarks = min(numLandmarks, (int) degrees.size());
+  partial_sort(degrees.begin(), degrees.begin() + numLandmarks, degrees.end());
+
+  vector<int> landmarks(numLandmarks);
+  for (int k = 0; k < numLandmarks; k++)
+    landmarks[k] = degrees[k].second;
+  return landmarks;
+}
+
+bool landmarkOracle::build(const imdb& db, const string& directory, int numLandmarks, int numThreads)
+{
+  vector<int> landmarks = pickLandmarks(db, numLandmarks);
+  numLandmarks = landmarks.size();
+  int numActors = db.getNumActors();
+  vector<unsigned char> table((size_t) numActors * numLandmarks);
+  
+  searchOptions options;
+  options.numThreads = numThreads;
+  for (int k = 0; k < numLandmarks; k++) {
+    distanceMap map;
+    searchStats stats;
+    computeDistances(db, db.getActorIdAt(landmarks[k]), options, map, stats);
+    for (int i = 0; i < numActors; i++)
+      table[(size_t) i * numLandmarks + k] = map.distances[i];
+  }
+
+  landmarkHeader header = { kLandmarkMagic, numLandmarks, numActors };
+  const string fileName = directory + "/" + kLandmarkFileName;
+  FILE *outfile = fopen(fileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+  bool written = 
+    fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+    fwrite(&landmarks[0], sizeof(int), numLandmarks, outfile) == (size_t) numLandmarks &&
+    fwrite(&table[0], 1, table.size(), outfile) == table.size();
+  if (fclose(outfile) != 0) written = false;
+  if (!written) remove(fileName.c_str());
+  return written;
+}
@@ -0,0 +1,97 @@
+#ifndef __landmarks__
+#define __landmarks__
+
+#include "imdb.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * Class: landmarkOracle
+ * ---------------------
+ * Bounds the degrees of separation between any two actors without
+ * searching.  An offline step picks the K actors with the most credits
+ * as landmarks and records every actor's distance from each of them.
+ * Because distances obey the triangle inequality, for every landmark L
+ *
+ *     |d(L, a) - d(L, b)|  <=  d(a, b)  <=  d(L, a) + d(L, b),
+ *
+ * so the tightest of those bounds over all K landmarks can be had by
+ * reading K bytes per actor.  An actor reachable from a landmark can't
+ * reach an actor the landmark can't, which proves there's no path at all.
+ */
+
+class landmarkOracle {
+ public:
+
+  /**
+   * Constant: kInfinite
+   * -------------------
+   * The bound reported when there's provably no path (as a lower bound)
+   * or no landmark reaches both actors (as an upper bound).
+   */
+
+  static const int kInfinite = 255;
+
+  /**
+   * Constructor: landmarkOracle
+   * ---------------------------
+   * Maps the landmark file in the specified directory, provided it was
+   * built from the data files the specified imdb is layered over.
+   */
+
+  landmarkOracle(const imdb& db, const string& directory);
+  ~landmarkOracle();
+
+  /**
+   * Predicate Method: good
+   * ----------------------
+   * Returns true if and only if the landmark file was loaded.
+   */
+
+  bool good() const { return distances != NULL; }
+
+  /**
+   * Method: getBounds
+   * -----------------
+   * Sets lower and upper to bounds on the number of movies on a shortest
+   * path between the two identified actors.  Takes time proportional to
+   * the number of landmarks once the actors' positions are known.
+   */
+
+  void getBounds(int sourceId, int targetId, int& lower, int& upper) const;
+
+  /**
+   * Method: getNumLandmarks
+   * -----------------------
+   * Returns the number of landmarks.
+   */
+
+  int getNumLandmarks() const { return numLandmarks; }
+
+  /**
+   * Static Method: build
+   * --------------------
+   * Picks the numLandmarks actors with the most credits, runs one
+   * breadth-first search out of each (spread across numThreads threads),
+   * and writes the distances to the landmark file in the specified directory.
+   *
+   * @return true if and only if the file was written successfully.
+   */
+
+  static bool build(const imdb& db, const string& directory, int numLandmarks, int numThreads);
+
+ private:
+  static const char *const kLandmarkFileName;
+  const imdb& db;
+  int fd;
+  size_t fileSize;
+  const void *fileMap;
+  int numLandmarks;
+  const unsigned char *distances; // numLandmarks bytes per actor, by position
+
+  landmarkOracle(const landmarkOracle& original);
+  landmarkOracle& operator=(const landmarkOracle& rhs);
+};
+
+#endif
@@ -7,35 +7,92 @@ using namespace std;
  * actor or actress to another actor or actress through a series
  * of movie-player connections.  A new path is always a partial
  * path because it only knows of the first player in the chain.
- * As a result, the embedded vector should be set to be empty, because
- * each entry in the vector is one leg in the path from an actor to
- * another.
+ * As a result, the chain should hold just the one connection for
+ * that player, because each later connection is one leg in the
+ * path from an actor to another.
  */
 
-path::path(const string& player) : startPlayer(player) {} 
-// ommission of links from init list calls the default constructor
+path::path(const string& player) : last(new connection(player)) {}
 
 /**
- * Simply tack on a new connection pair to the end of the links vector.
+ * Copies share the chain of connections, so copying just takes another
+ * reference to its last connection.  The counts are updated atomically
+ * because paths sharing a prefix may be handed to other threads.
+ */
+
+path::path(const path& other) : last(retain(other.last)) {}
+
+path& path::operator=(const path& other)
+{
+  connection *previous = last;
+  last = retain(other.last);
+  release(previous); // after retaining, in case other is this
+  return *this;
+}
+
+path::~path()
+{
+  release(last);
+}
+
+path::connection *path::retain(connection *c)
+{
+  __atomic_add_fetch(&c->refCount, 1, __ATOMIC_RELAXED);
+  return c;
+}
+
+/**
+ * Drops a reference to the connection, deleting it (and then dropping
+ * its reference to the connection before it) once nothing refers to it.
+ * Iterates rather than recurses, so long chains can't blow the stack.
+ */
+
+void path::release(connection *c)
+{
+  while (c != NULL && __atomic_sub_fetch(&c->refCount, 1, __ATOMIC_ACQ_REL) == 0) {
+    connection *previous = c->previous;
+    delete c;
+    c = previous;
+  }
+}
+
+/**
+ * Simply tack on a new connection pair to the end of the chain.
  * It ain't our business to be checking for consistency of connection, as
  * that's the resposibility of the surrounding class to decide (or at
- * least we're making it their business.
+ * least we're making it their business.  The new connection takes over
+ * this path's reference to the old last one.
  */
 
 void path::addConnection(const film& movie, const string& player)
 {
-  links.push_back(connection(movie, player));
-} 
+  last = new connection(movie, player, last);
+}
 
 /**
- * Remove the last connection pair 
+ * Remove the last connection pair
  * if there is one.
  */
 
 void path::undoConnection()
 {
-  if (links.size() == 0) return;
-  links.pop_back();
+  if (last->length == 0) return;
+  connection *previous = retain(last->previous);
+  release(last);
+  last = previous;
+}
+
+/**
+ * Lists the path's connections after the first player, in order
+ * from the first player to the last.
+ */
+
+void path::collectLinks(vector<const connection *>& links) const
+{
+  links.resize(last->length);
+  const connection *c = last;
+  for (int i = last->length - 1; i >= 0; i--, c = c->previous)
+    links[i] = c;
 }
 
 /**
@@ -49,32 +106,28 @@ void path::printPathLine(const string& actor1, const string& actor2,
 
 void path::print()
 {
-  if (links.size() > 0)
-    printPathLine(startPlayer, links[0].player, links[0].movie);
-  
-  for (int i = 1; i < links.size(); i++) 
-    printPathLine(links[i-1].player, links[i].player, links[i].movie);
+  vector<const connection *> links;
+  collectLinks(links);
+  for (int i = 0; i < (int) links.size(); i++)
+    printPathLine(links[i]->previous->player, links[i]->player, links[i]->movie);
 }
 
 /**
- * Returns the last player (actor/actress) currently 
+ * Returns the last player (actor/actress) currently
  * in the path.
  */
 
 const string& path::getLastPlayer() const
 {
-  if (links.size() == 0) return startPlayer;
-  return links.back().player;
+  return last->player;
 }
 
 void path::reverse()
 {
   // construct the reverse
   path reverseOfPath(getLastPlayer());
-  for (int i = links.size() - 1; i > 0; i--)
-    reverseOfPath.addConnection(links[i].movie, links[i-1].player);
-  if (links.size() > 0)
-    reverseOfPath.addConnection(links[0].movie, startPlayer);
+  for (const connection *c = last; c->length > 0; c = c->previous)
+    reverseOfPath.addConnection(c->movie, c->previous->player);
 
   // then assign self to its reverse
   *this = reverseOfPath;
@@ -82,14 +135,14 @@ void path::reverse()
 
 ostream& operator<<(ostream& os, const path& p)
 {
-  if (p.links.size() == 0) return os << string("[Empty path]") << endl;
-  
-  os << "\t" << p.startPlayer << " was in ";
-  for (int i = 0; i < (int) p.links.size(); i++) {
-    os << "\"" << p.links[i].movie.title << "\" (" << p.links[i].movie.year << ") with " 
-       << p.links[i].player << "." << endl;
-    if (i + 1 == (int) p.links.size()) break;
-    os << "\t" << p.links[i].player << " was in ";
+  if (p.getLength() == 0) return os << string("[Empty path]") << endl;
+
+  vector<const path::connection *> links;
+  p.collectLinks(links);
+  for (int i = 0; i < (int) links.size(); i++) {
+    os << "\t" << links[i]->previous->player << " was in "
+       << "\"" << links[i]->movie.title << "\" (" << links[i]->movie.year << ") with "
+       << links[i]->player << "." << endl;
   }
 
   return os;
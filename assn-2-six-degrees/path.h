@@ -15,6 +15,13 @@ using namespace std;
  * of the consistency checks one might want.  You're
  * free to change this code to include those consistency
  * checks, or you may leave it alone and use it as is.
+ *
+ * A path is a handle on the last of a chain of reference-counted
+ * connections, each linked to the one before it, so paths extended from
+ * a common prefix share that prefix rather than each holding a copy.
+ * Copying a path is therefore constant time and copies no strings, and
+ * extending it copies just the one new movie and player.  Connections
+ * are never changed once made, so sharing is invisible to clients.
  */
 
 class path {
@@ -49,6 +56,17 @@ class path {
 
   path(const string& startPlayer);
 
+  /**
+   * Copy Constructor, Assignment Operator, Destructor
+   * -------------------------------------------------
+   * Share the other path's chain of connections rather than copying it,
+   * and let go of the chain once no path refers to it any more.
+   */
+
+  path(const path& other);
+  path& operator=(const path& other);
+  ~path();
+
   /**
    * Method: getLength
    * -----------------
@@ -59,7 +77,7 @@ class path {
    *         path.
    */
   
-  int getLength() const { return links.size(); };
+  int getLength() const { return last->length; };
 
   /**
    * Method: addConnection
@@ -75,7 +93,8 @@ class path {
    * 
    * The implementation makes a deep copy of the specified movie and
    * actor, so you needn't worry about the memory management issues that
-   * come up here.
+   * come up here.  Other paths sharing this one's connections are left
+   * as they were.
    *
    * @param movie a reference to the film record starring both the specified
    *              player and the last player in the path.
@@ -128,17 +147,27 @@ class path {
   // if you think about it, the existence of this struct is really an implementation detail,
   // so its very definition should be private, right?
 
+  // the first player in a path is a connection with no movie and no previous
+  // connection; refCount counts the paths and later connections pointing here
   struct connection {
     film movie;
     string player;
+    connection *previous;
+    int length;
+    int refCount;
     
     // convenience struct with constructors.. 
-    connection() {}
-    connection(const film& movie, const string& player) : movie(movie), player(player) {}
+    connection(const string& player) : player(player), previous(NULL), length(0), refCount(1) {}
+    connection(const film& movie, const string& player, connection *previous) :
+      movie(movie), player(player), previous(previous), length(previous->length + 1), 
+      refCount(1) {}
   };
+
+  static connection *retain(connection *c);
+  static void release(connection *c);
+  void collectLinks(vector<const connection *>& links) const;
   
-  string startPlayer;
-  vector<connection> links;
+  connection *last;
 };
 
 #endif
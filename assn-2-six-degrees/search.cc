@@ -0,0 +1,881 @@
+#include "search.h"
+#include "landmarks.h"
+#include "degrees.h"
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <pthread.h>
+using namespace std;
+
+/**
+ * Class: idBitmap
+ * ---------------
+ * A set of ids stored as one bit per possible id.  Membership tests
+ * and insertions are a shift and a mask away, and nothing is allocated
+ * once the bitmap has been constructed.
+ */
+
+class idBitmap {
+ public:
+  idBitmap(int idLimit) : words((idLimit + kBitsPerWord - 1) / kBitsPerWord, 0) {}
+
+  bool contains(int id) const {
+    return (words[id / kBitsPerWord] >> (id % kBitsPerWord)) & 1;
+  }
+
+  // returns true if and only if the id wasn't already present
+  bool insert(int id) {
+    unsigned long& word = words[id / kBitsPerWord];
+    unsigned long mask = 1UL << (id % kBitsPerWord);
+    if (word & mask) return false;
+    word |= mask;
+    return true;
+  }
+
+  // like insert, but safe to call from several threads at once
+  bool insertAtomic(int id) {
+    unsigned long mask = 1UL << (id % kBitsPerWord);
+    return !(__atomic_fetch_or(&words[id / kBitsPerWord], mask, __ATOMIC_RELAXED) & mask);
+  }
+
+ private:
+  static const int kBitsPerWord = 8 * sizeof(unsigned long);
+  vector<unsigned long> words;
+};
+
+/**
+ * Convenience struct: reachedActor
+ * --------------------------------
+ * One entry in a search's parent-pointer array: the actor reached, the
+ * movie that reached it, and the index (within the same array) of the
+ * actor it was reached from.  The root has no movie and a parent of -1.
+ */
+
+struct reachedActor {
+  int actorId;
+  int movieId;
+  int parent;
+};
+
+/**
+ * Convenience struct: searchSide
+ * ------------------------------
+ * Everything one breadth-first search needs to know.  The reached array
+ * doubles as the search queue: the actors from levelStart to the end
+ * are the frontier, all of them depth movies away from the root.
+ */
+
+struct searchSide {
+  vector<reachedActor> reached;
+  idBitmap actors;
+  idBitmap movies;
+  int levelStart;
+  int depth;
+  int filmsVisited;
+  int actorsExpanded;
+  const movieFilter *filter;
+
+  searchSide(const imdb& db, int rootId, const movieFilter *filter) :
+    actors(db.getActorIdLimit()), movies(db.getMovieIdLimit()),
+    levelStart(0), depth(0), filmsVisited(0), actorsExpanded(0), filter(filter) {
+    reachedActor root = { rootId, imdb::kNoSuchId, -1 };
+    reached.push_back(root);
+    actors.insert(rootId);
+  }
+
+  int frontierSize() const { return reached.size() - levelStart; }
+
+  // a rejected movie stays marked in movies, so it's only ever tested once
+  bool admits(const imdb& db, int movieId) const {
+    return filter == NULL || filter->accepts(db, movieId);
+  }
+
+  int indexOf(int actorId) const {
+    for (int i = reached.size() - 1; i >= 0; i--)
+      if (reached[i].actorId == actorId) return i;
+    return -1;
+  }
+};
+
+/**
+ * Expands every actor in the side's frontier by one movie, so that the
+ * newly reached actors become the frontier.  Stops and returns true as soon
+ * as it reaches an actor the other side has already reached, or, when there
+ * is no other side, the target.  The actor in question is recorded in
+ * meetingId.  Because whole levels are expanded at a time, the first
+ * meeting found always lies on a shortest path.
+ */
+
+static bool expandFrontier(const imdb& db, searchSide& side, const searchSide *other,
+			   int targetId, int& meetingId)
+{
+  int levelEnd = side.reached.size();
+  for (int i = side.levelStart; i < levelEnd; i++) {
+    side.actorsExpanded++;
+    const int *movieIds;
+    int numCredits = db.getCreditIds(side.reached[i].actorId, movieIds);
+
+    for (int j = 0; j < numCredits; j++) {
+      if (!side.movies.insert(movieIds[j]) || !side.admits(db, movieIds[j])) continue;
+      side.filmsVisited++;
+      const int *actorIds;
+      int numActors = db.getCastIds(movieIds[j], actorIds);
+
+      for (int k = 0; k < numActors; k++) {
+	if (!side.actors.insert(actorIds[k])) continue;
+	reachedActor next = { actorIds[k], movieIds[j], i };
+	side.reached.push_back(next);
+	if (other == NULL ? actorIds[k] == targetId : other->actors.contains(actorIds[k])) {
+	  meetingId = actorIds[k];
+	  return true;
+	}
+      }
+    }
+  }
+
+  side.levelStart = levelEnd;
+  side.depth++;
+  return false;
+}
+
+/**
+ * Function type: rangeFunction
+ * ----------------------------
+ * The work parallelFor hands each thread: items start up to (but not
+ * including) end, which make up the specified chunk of the whole.
+ */
+
+typedef void (*rangeFunction)(int chunk, int start, int end, void *auxData);
+
+struct rangeTask {
+  rangeFunction fn;
+  int chunk;
+  int start;
+  int end;
+  void *auxData;
+};
+
+static void *runRangeTask(void *data)
+{
+  rangeTask *task = (rangeTask *) data;
+  task->fn(task->chunk, task->start, task->end, task->auxData);
+  return NULL;
+}
+
+/**
+ * Splits items 0 through numItems - 1 into numChunks contiguous chunks
+ * of nearly equal size and calls fn on each chunk, each in its own thread
+ * (the calling thread takes the first), returning once all have finished.
+ */
+
+static void parallelFor(int numItems, int numChunks, rangeFunction fn, void *auxData)
+{
+  vector<rangeTask> tasks(numChunks);
+  vector<pthread_t> threads(numChunks);
+  for (int i = 0; i < numChunks; i++) {
+    rangeTask task = { fn, i, (int) ((long long) numItems * i / numChunks),
+		       (int) ((long long) numItems * (i + 1) / numChunks), auxData };
+    tasks[i] = task;
+  }
+
+  for (int i = 1; i < numChunks; i++)
+    pthread_create(&threads[i], NULL, runRangeTask, &tasks[i]);
+  runRangeTask(&tasks[0]);
+  for (int i = 1; i < numChunks; i++)
+    pthread_join(threads[i], NULL);
+}
+
+/**
+ * Lowers the 64-bit value at the specified address to the specified value,
+ * unless it's already lower, even as other threads try to do the same.
+ */
+
+static void atomicMin(unsigned long long *word, unsigned long long value)
+{
+  unsigned long long current = __atomic_load_n(word, __ATOMIC_RELAXED);
+  while (value < current &&
+	 !__atomic_compare_exchange_n(word, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/**
+ * Frontiers smaller than this are expanded by expandFrontier alone, since
+ * starting threads would cost more than it could save.
+ */
+
+static const int kMinParallelFrontier = 256;
+
+/**
+ * Discovery keys
+ * --------------
+ * expandFrontier reaches new actors in a definite order: by the frontier
+ * position of the actor it expands, then by the index of the movie in that
+ * actor's credits, then by the index of the new actor in that movie's cast.
+ * Packing the three (cast and credit counts are shorts, so 15 bits apiece
+ * suffice) into one integer lets concurrent threads agree on that order by
+ * keeping the least key seen for each movie and actor.
+ */
+
+static const int kIndexBits = 15;
+static const unsigned long long kIndexMask = (1ULL << kIndexBits) - 1;
+static const unsigned long long kNoKey = ~0ULL;
+
+/**
+ * Convenience struct: parallelLevel
+ * ---------------------------------
+ * Everything the threads expanding one level of a frontier share.  The
+ * movies and actors reached at this level are collected per chunk and
+ * then merged into sorted arrays, alongside which the least discovery key
+ * for each is kept.
+ */
+
+struct parallelLevel {
+  const imdb *db;
+  searchSide *side;
+  vector<vector<int> > chunkMovies;
+  vector<vector<int> > chunkActors;
+  vector<int> movies;
+  vector<unsigned long long> movieKeys;
+  vector<int> actors;
+  vector<unsigned long long> actorKeys;
+
+  int frontierActor(int position) const { 
+    return side->reached[side->levelStart + position].actorId; 
+  }
+};
+
+/**
+ * Returns the position of id within the sorted array of ids, or -1 if
+ * it's not there.
+ */
+
+static int positionOf(const vector<int>& ids, int id)
+{
+  vector<int>::const_iterator found = lower_bound(ids.begin(), ids.end(), id);
+  return (found == ids.end() || *found != id) ? -1 : found - ids.begin();
+}
+
+/**
+ * Concatenates the chunks' ids into one sorted array and readies a
+ * matching array of keys.
+ */
+
+static void mergeChunks(const vector<vector<int> >& chunks, vector<int>& ids,
+			vector<unsigned long long>& keys)
+{
+  for (int i = 0; i < (int) chunks.size(); i++)
+    ids.insert(ids.end(), chunks[i].begin(), chunks[i].end());
+  sort(ids.begin(), ids.end());
+  keys.assign(ids.size(), kNoKey);
+}
+
+/**
+ * First pass: marks every not-yet-expanded movie the frontier actors
+ * appeared in, collecting the movies each chunk marked.
+ */
+
+static void collectLevelMovies(int chunk, int start, int end, void *auxData)
+{
+  parallelLevel *level = (parallelLevel *) auxData;
+  for (int p = start; p < end; p++) {
+    const int *movieIds;
+    int numCredits = level->db->getCreditIds(level->frontierActor(p), movieIds);
+    for (int j = 0; j < numCredits; j++)
+      if (level->side->movies.insertAtomic(movieIds[j]) && level->side->admits(*level->db, movieIds[j])) 
+	level->chunkMovies[chunk].push_back(movieIds[j]);
+  }
+}
+
+/**
+ * Second pass: keys each of the level's movies by the frontier actor that
+ * expandFrontier would have expanded it from, and where it falls in that
+ * actor's credits.
+ */
+
+static void keyLevelMovies(int chunk, int start, int end, void *auxData)
+{
+  parallelLevel *level = (parallelLevel *) auxData;
+  for (int p = start; p < end; p++) {
+    const int *movieIds;
+    int numCredits = level->db->getCreditIds(level->frontierActor(p), movieIds);
+    for (int j = 0; j < numCredits; j++) {
+      int index = positionOf(level->movies, movieIds[j]);
+      if (index != -1) atomicMin(&level->movieKeys[index], ((unsigned long long) p << kIndexBits) | j);
+    }
+  }
+}
+
+/**
+ * Third pass: marks every not-yet-reached actor in the casts of the
+ * level's movies, collecting the actors each chunk marked.
+ */
+
+static void collectLevelActors(int chunk, int start, int end, void *auxData)
+{
+  parallelLevel *level = (parallelLevel *) auxData;
+  for (int m = start; m < end; m++) {
+    const int *actorIds;
+    int numActors = level->db->getCastIds(level->movies[m], actorIds);
+    for (int k = 0; k < numActors; k++)
+      if (level->side->actors.insertAtomic(actorIds[k])) 
+	level->chunkActors[chunk].push_back(actorIds[k]);
+  }
+}
+
+/**
+ * Fourth pass: keys each of the level's actors by the first movie
+ * expandFrontier would have reached it through.
+ */
+
+static void keyLevelActors(int chunk, int start, int end, void *auxData)
+{
+  parallelLevel *level = (parallelLevel *) auxData;
+  for (int m = start; m < end; m++) {
+    const int *actorIds;
+    int numActors = level->db->getCastIds(level->movies[m], actorIds);
+    for (int k = 0; k < numActors; k++) {
+      int index = positionOf(level->actors, actorIds[k]);
+      if (index != -1) atomicMin(&level->actorKeys[index], (level->movieKeys[m] << kIndexBits) | k);
+    }
+  }
+}
+
+/**
+ * Same contract as expandFrontier, but splits the work of expanding the
+ * frontier across as many as numThreads threads.  The whole level is always
+ * reached before the actors are appended to the side's reached array in
+ * the order expandFrontier would have appended them, so the meeting point
+ * and every parent along the way are exactly the ones expandFrontier
+ * would have chosen.
+ */
+
+static bool expandFrontierParallel(const imdb& db, searchSide& side, const searchSide *other,
+				   int targetId, int& meetingId, int numThreads)
+{
+  int frontierSize = side.frontierSize();
+  if (numThreads <= 1 || frontierSize < kMinParallelFrontier)
+    return expandFrontier(db, side, other, targetId, meetingId);
+
+  parallelLevel level;
+  level.db = &db;
+  level.side = &side;
+  level.chunkMovies.resize(numThreads);
+  level.chunkActors.resize(numThreads);
+
+  parallelFor(frontierSize, numThreads, collectLevelMovies, &level);
+  mergeChunks(level.chunkMovies, level.movies, level.movieKeys);
+  parallelFor(frontierSize, numThreads, keyLevelMovies, &level);
+  side.filmsVisited += level.movies.size();
+  side.actorsExpanded += frontierSize;
+
+  int numMovies = level.movies.size();
+  int numChunks = min(numThreads, max(numMovies, 1));
+  parallelFor(numMovies, numChunks, collectLevelActors, &level);
+  mergeChunks(level.chunkActors, level.actors, level.actorKeys);
+  parallelFor(numMovies, numChunks, keyLevelActors, &level);
+
+  vector<pair<unsigned long long, int> > discovered(level.actors.size());
+  for (int i = 0; i < (int) level.actors.size(); i++)
+    discovered[i] = make_pair(level.actorKeys[i], level.actors[i]);
+  sort(discovered.begin(), discovered.end());
+
+  int levelEnd = side.reached.size();
+  for (int i = 0; i < (int) discovered.size(); i++) {
+    unsigned long long key = discovered[i].first;
+    int parent = side.levelStart + (int) (key >> (2 * kIndexBits));
+    const int *movieIds;
+    db.getCreditIds(side.reached[parent].actorId, movieIds);
+    reachedActor next = { discovered[i].second, movieIds[(key >> kIndexBits) & kIndexMask], parent };
+    side.reached.push_back(next);
+    if (other == NULL ? next.actorId == targetId : other->actors.contains(next.actorId)) {
+      meetingId = next.actorId;
+      return true;
+    }
+  }
+
+  side.levelStart = levelEnd;
+  side.depth++;
+  return false;
+}
+
+/**
+ * Appends the connections leading from the forward search's root to the
+ * reached actor at the specified index onto the end of the path.
+ */
+
+static void appendPathFromRoot(const imdb& db, const searchSide& side, int index, path& p)
+{
+  vector<int> chain;
+  for (; side.reached[index].parent != -1; index = side.reached[index].parent)
+    chain.push_back(index);
+
+  for (int i = chain.size() - 1; i >= 0; i--) {
+    const reachedActor& r = side.reached[chain[i]];
+    p.addConnection(db.getFilm(r.movieId), db.getActorName(r.actorId));
+  }
+}
+
+/**
+ * Appends the connections leading from the reached actor at the specified
+ * index back to the backward search's root onto the end of the path.
+ */
+
+static void appendPathToRoot(const imdb& db, const searchSide& side, int index, path& p)
+{
+  for (; side.reached[index].parent != -1; index = side.reached[index].parent) {
+    const reachedActor& r = side.reached[index];
+    p.addConnection(db.getFilm(r.movieId), db.getActorName(side.reached[r.parent].actorId));
+  }
+}
+
+/**
+ * Breadth-first search outward from the source alone.
+ */
+
+static bool findShortestPathUnidirectional(const imdb& db, int sourceId, int targetId,
+					   const searchOptions& options, path& result,
+					   searchStats& stats)
+{
+  int numThreads = options.numThreads;
+  searchSide forward(db, sourceId, options.filter);
+  int meetingId = imdb::kNoSuchId;
+  bool found = false;
+  while (!found && forward.frontierSize() > 0 && forward.depth < kMaxPathLength)
+    found = expandFrontierParallel(db, forward, NULL, targetId, meetingId, numThreads);
+
+  stats.actorsVisited = forward.reached.size();
+  stats.filmsVisited = forward.filmsVisited;
+  stats.actorsExpanded = forward.actorsExpanded;
+  if (!found) return false;
+
+  result = path(db.getActorName(sourceId));
+  appendPathFromRoot(db, forward, forward.reached.size() - 1, result);
+  return true;
+}
+
+/**
+ * Returns what expanding the side's frontier would cost: the credits of
+ * the actors on it, read from the degree table, or without one, just the
+ * number of actors.
+ */
+
+static long frontierCost(const searchSide& side, const degreeTable *degrees)
+{
+  if (degrees == NULL) return side.frontierSize();
+  long cost = 0;
+  for (int i = side.levelStart; i < (int) side.reached.size(); i++)
+    cost += degrees->getCredits(side.reached[i].actorId);
+  return cost;
+}
+
+/**
+ * Searches from both ends at once, always expanding whichever frontier
+ * is smaller (or cheaper, given degrees), until the two searches meet in
+ * the middle.
+ */
+
+static bool findShortestPathBidirectional(const imdb& db, int sourceId, int targetId,
+					  const searchOptions& options, path& result,
+					  searchStats& stats)
+{
+  int numThreads = options.numThreads;
+  searchSide forward(db, sourceId, options.filter);
+  searchSide backward(db, targetId, options.filter);
+  int meetingId = imdb::kNoSuchId;
+  bool found = false;
+  while (!found && forward.frontierSize() > 0 && backward.frontierSize() > 0 &&
+	 forward.depth + backward.depth < kMaxPathLength) {
+    if (frontierCost(forward, options.degrees) <= frontierCost(backward, options.degrees)) {
+      found = expandFrontierParallel(db, forward, &backward, targetId, meetingId, numThreads);
+    } else {
+      found = expandFrontierParallel(db, backward, &forward, sourceId, meetingId, numThreads);
+    }
+  }
+
+  stats.actorsVisited = forward.reached.size() + backward.reached.size();
+  stats.filmsVisited = forward.filmsVisited + backward.filmsVisited;
+  stats.actorsExpanded = forward.actorsExpanded + backward.actorsExpanded;
+  if (!found) return false;
+
+  result = path(db.getActorName(sourceId));
+  appendPathFromRoot(db, forward, forward.indexOf(meetingId), result);
+  appendPathToRoot(db, backward, backward.indexOf(meetingId), result);
+  return true;
+}
+
+/**
+ * A* search from the source towards the target, using the landmarks'
+ * lower bound on each actor's distance to the target as the heuristic.
+ * That bound is consistent, so an actor's first expansion is always by
+ * way of a shortest path, and the search is over as soon as the target
+ * comes up for expansion.  Actors whose bound puts every path through
+ * them over kMaxPathLength movies are never queued.  The open list is
+ * a grid of buckets indexed by estimated path length and by distance
+ * from the source; among equal estimates, the actor furthest from the
+ * source (and so likely nearest the target) goes first.  Every per-actor
+ * and per-movie array is indexed by dense id.
+ */
+
+static bool findShortestPathGoalDirected(const imdb& db, int sourceId, int targetId,
+					 const landmarkOracle& landmarks, const movieFilter *filter,
+					 path& result, searchStats& stats)
+{
+  const unsigned char kUnseen = 255;
+  vector<unsigned char> actorDistances(db.getActorIdLimit(), kUnseen);
+  vector<unsigned char> movieDistances(db.getMovieIdLimit(), kUnseen);
+  vector<reachedActor> reached;
+  vector<unsigned char> reachedDistances;
+  vector<int> open[kMaxPathLength + 1][kMaxPathLength + 1];
+
+  int lower, upper;
+  landmarks.getBounds(sourceId, targetId, lower, upper);
+  if (lower <= kMaxPathLength) {
+    reachedActor root = { sourceId, imdb::kNoSuchId, -1 };
+    reached.push_back(root);
+    reachedDistances.push_back(0);
+    actorDistances[sourceId] = 0;
+    open[lower][0].push_back(0);
+  }
+
+  int found = -1;
+  for (int f = 0; found == -1 && f <= kMaxPathLength; f++) {
+    for (int g = f; found == -1 && g >= 0; g--) {
+      while (found == -1 && !open[f][g].empty()) {
+	int index = open[f][g].back();
+	open[f][g].pop_back();
+	int actorId = reached[index].actorId;
+	if (reachedDistances[index] != actorDistances[actorId]) continue; // superseded
+	if (actorId == targetId) {
+	  found = index;
+	  break;
+	}
+
+	stats.actorsExpanded++;
+	const int *movieIds;
+	int numCredits = db.getCreditIds(actorId, movieIds);
+	for (int j = 0; j < numCredits; j++) {
+	  if (movieDistances[movieIds[j]] <= g) continue;
+	  if (filter != NULL && !filter->accepts(db, movieIds[j])) {
+	    movieDistances[movieIds[j]] = 0; // so it's never tested again
+	    continue;
+	  }
+	  movieDistances[movieIds[j]] = g;
+	  stats.filmsVisited++;
+	  const int *actorIds;
+	  int numActors = db.getCastIds(movieIds[j], actorIds);
+	  for (int k = 0; k < numActors; k++) {
+	    if (actorDistances[actorIds[k]] <= g + 1) continue;
+	    if (actorDistances[actorIds[k]] == kUnseen) stats.actorsVisited++;
+	    actorDistances[actorIds[k]] = g + 1;
+	    landmarks.getBounds(actorIds[k], targetId, lower, upper);
+	    if (g + 1 + lower > kMaxPathLength) continue;
+	    reachedActor next = { actorIds[k], movieIds[j], index };
+	    reached.push_back(next);
+	    reachedDistances.push_back(g + 1);
+	    // a consistent heuristic never lets f shrink along a path
+	    open[g + 1 + lower][g + 1].push_back(reached.size() - 1);
+	  }
+	}
+      }
+      // expanding an actor may queue more actors with this same estimate,
+      // one movie further from the source
+      if (found == -1 && g < f && !open[f][g + 1].empty()) g += 2;
+    }
+  }
+
+  if (found == -1) return false;
+  vector<int> chain;
+  for (int index = found; reached[index].parent != -1; index = reached[index].parent)
+    chain.push_back(index);
+  result = path(db.getActorName(sourceId));
+  for (int i = chain.size() - 1; i >= 0; i--) {
+    const reachedActor& r = reached[chain[i]];
+    result.addConnection(db.getFilm(r.movieId), db.getActorName(r.actorId));
+  }
+  return true;
+}
+
+bool findShortestPath(const imdb& db, int sourceId, int targetId,
+		      const searchOptions& options, path& result, searchStats& stats)
+{
+  if (options.landmarks != NULL) {
+    int lower, upper;
+    options.landmarks->getBounds(sourceId, targetId, lower, upper);
+    if (lower > kMaxPathLength) return false;
+    if (options.goalDirected && db.hasDenseIds())
+      return findShortestPathGoalDirected(db, sourceId, targetId, *options.landmarks, options.filter,
+					  result, stats);
+  }
+  
+  if (options.bidirectional)
+    return findShortestPathBidirectional(db, sourceId, targetId, options, result, stats);
+  return findShortestPathUnidirectional(db, sourceId, targetId, options, result, stats);
+}
+
+/**
+ * Convenience class: positionIndex
+ * --------------------------------
+ * Converts actor or movie ids back into the positions imdb::getActorIdAt
+ * and imdb::getMovieIdAt take, by binary searching every (id, position)
+ * pair sorted by id.
+ */
+
+class positionIndex {
+ public:
+  positionIndex(const imdb& db, bool actors) {
+    int numRecords = actors ? db.getNumActors() : db.getNumMovies();
+    pairs.resize(numRecords);
+    for (int i = 0; i < numRecords; i++)
+      pairs[i] = make_pair(actors ? db.getActorIdAt(i) : db.getMovieIdAt(i), i);
+    sort(pairs.begin(), pairs.end());
+  }
+
+  int positionOf(int id) const {
+    return lower_bound(pairs.begin(), pairs.end(), make_pair(id, 0))->second;
+  }
+
+ private:
+  vector<pair<int, int> > pairs;
+};
+
+void computeDistances(const imdb& db, int sourceId, const searchOptions& options,
+		      distanceMap& result, searchStats& stats)
+{
+  searchSide side(db, sourceId, options.filter);
+  vector<int> levelStarts(1, 0);
+  int meetingId;
+  while (side.frontierSize() > 0) {
+    // nobody has the id kNoSuchId, so the expansion never stops early
+    expandFrontierParallel(db, side, NULL, imdb::kNoSuchId, meetingId, options.numThreads);
+    levelStarts.push_back(side.levelStart);
+  }
+  stats.actorsVisited = side.reached.size();
+  stats.filmsVisited = side.filmsVisited;
+  stats.actorsExpanded = side.actorsExpanded;
+
+  positionIndex actorPositions(db, true), moviePositions(db, false);
+  int numActors = db.getNumActors();
+  result.sourcePosition = actorPositions.positionOf(sourceId);
+  result.distances.assign(numActors, kUnreachable);
+  result.parents.assign(numActors, -1);
+  result.movies.assign(numActors, -1);
+
+  vector<int> reachedPositions(side.reached.size());
+  for (int depth = 0; depth + 1 < (int) levelStarts.size(); depth++) {
+    for (int i = levelStarts[depth]; i < levelStarts[depth + 1]; i++) {
+      const reachedActor& r = side.reached[i];
+      int position = reachedPositions[i] = actorPositions.positionOf(r.actorId);
+      result.distances[position] = min(depth, (int) kUnreachable - 1);
+      if (r.parent == -1) continue;
+      result.parents[position] = reachedPositions[r.parent];
+      result.movies[position] = moviePositions.positionOf(r.movieId);
+    }
+  }
+}
+
+static const int kDistanceMapMagic = 0x44495331; // "DIS1"
+
+bool writeDistances(const distanceMap& map, const string& fileName)
+{
+  FILE *outfile = fopen(fileName.c_str(), "wb");
+  if (outfile == NULL) return false;
+
+  int numActors = map.distances.size();
+  int header[] = { kDistanceMapMagic, numActors, map.sourcePosition };
+  vector<unsigned char> distances(map.distances);
+  distances.resize((numActors + 3) / 4 * 4, 0);
+  bool written = 
+    fwrite(header, sizeof(int), 3, outfile) == 3 &&
+    fwrite(&distances[0], 1, distances.size(), outfile) == distances.size() &&
+    fwrite(&map.parents[0], sizeof(int), numActors, outfile) == (size_t) numActors &&
+    fwrite(&map.movies[0], sizeof(int), numActors, outfile) == (size_t) numActors;
+  if (fclose(outfile) != 0) written = false;
+  if (!written) remove(fileName.c_str());
+  return written;
+}
+
+/**
+ * Adds the next level to a breadth-first search that keeps one list of
+ * actors per depth, marking every actor and movie it reaches, and then
+ * sorts the new level so membership can be tested by binary search.
+ */
+
+static void expandLevel(const imdb& db, const movieFilter *filter, vector<vector<int> >& levels,
+			idBitmap& actors, idBitmap& movies)
+{
+  vector<int> next;
+  const vector<int>& frontier = levels.back();
+  for (int i = 0; i < (int) frontier.size(); i++) {
+    const int *movieIds;
+    int numCredits = db.getCreditIds(frontier[i], movieIds);
+    for (int j = 0; j < numCredits; j++) {
+      if (!movies.insert(movieIds[j])) continue;
+      if (filter != NULL && !filter->accepts(db, movieIds[j])) continue;
+      const int *actorIds;
+      int numActors = db.getCastIds(movieIds[j], actorIds);
+      for (int k = 0; k < numActors; k++) {
+	if (actors.insert(actorIds[k])) next.push_back(actorIds[k]);
+      }
+    }
+  }
+
+  sort(next.begin(), next.end());
+  levels.push_back(next);
+}
+
+/**
+ * Each round expands whichever side has the smaller frontier by a whole
+ * level.  The first level to reach actors the other side has reached
+ * can only reach them at the other side's deepest level (any earlier,
+ * and the two would have met a round sooner), so those actors are
+ * exactly the ones every shortest path passes through at that depth.
+ */
+
+shortestPathEnumerator::shortestPathEnumerator(const imdb& db, int sourceId, int targetId,
+					       const movieFilter *filter) :
+  db(db), filter(filter), sourceId(sourceId), length(-1), sourceDepth(0), started(false)
+{
+  idBitmap sourceActors(db.getActorIdLimit()), sourceMovies(db.getMovieIdLimit());
+  idBitmap targetActors(db.getActorIdLimit()), targetMovies(db.getMovieIdLimit());
+  fromSource.levels.push_back(vector<int>(1, sourceId));
+  fromTarget.levels.push_back(vector<int>(1, targetId));
+  sourceActors.insert(sourceId);
+  targetActors.insert(targetId);
+
+  if (sourceId == targetId) meetings.push_back(sourceId);
+  while (meetings.empty() && 
+	 (int) (fromSource.levels.size() + fromTarget.levels.size()) - 2 < kMaxPathLength &&
+	 !fromSource.levels.back().empty() && !fromTarget.levels.back().empty()) {
+    bool expandSource = fromSource.levels.back().size() <= fromTarget.levels.back().size();
+    if (expandSource) {
+      expandLevel(db, filter, fromSource.levels, sourceActors, sourceMovies);
+    } else {
+      expandLevel(db, filter, fromTarget.levels, targetActors, targetMovies);
+    }
+    const vector<int>& level = (expandSource ? fromSource : fromTarget).levels.back();
+    const idBitmap& other = expandSource ? targetActors : sourceActors;
+    for (int i = 0; i < (int) level.size(); i++) {
+      if (other.contains(level[i])) meetings.push_back(level[i]);
+    }
+  }
+
+  if (meetings.empty()) return;
+  sourceDepth = fromSource.levels.size() - 1;
+  length = sourceDepth + fromTarget.levels.size() - 1;
+  linkPredecessors(fromSource, sourceDepth);
+  linkPredecessors(fromTarget, length - sourceDepth);
+  choices.resize(length + 1, 0);
+  actors.resize(length + 1, 0);
+}
+
+/**
+ * Walks back from the meeting actors, at the given depth on the side,
+ * to the side's root, recording the predecessor list of every actor on
+ * the way: every (movie, actor) pair linking it to the level before.
+ */
+
+void shortestPathEnumerator::linkPredecessors(dagSide& side, int depth)
+{
+  vector<int> onPaths(meetings);
+  for (; depth > 0; depth--) {
+    const vector<int>& previous = side.levels[depth - 1];
+    vector<int> next;
+    for (int i = 0; i < (int) onPaths.size(); i++) {
+      vector<dagLink>& links = side.predecessors[onPaths[i]];
+      const int *movieIds;
+      int numCredits = db.getCreditIds(onPaths[i], movieIds);
+      for (int j = 0; j < numCredits; j++) {
+	if (filter != NULL && !filter->accepts(db, movieIds[j])) continue;
+	const int *actorIds;
+	int numActors = db.getCastIds(movieIds[j], actorIds);
+	for (int k = 0; k < numActors; k++) {
+	  if (!binary_search(previous.begin(), previous.end(), actorIds[k])) continue;
+	  dagLink link = { movieIds[j], actorIds[k] };
+	  links.push_back(link);
+	  next.push_back(actorIds[k]);
+	}
+      }
+    }
+    sort(next.begin(), next.end());
+    next.erase(unique(next.begin(), next.end()), next.end());
+    onPaths.swap(next);
+  }
+}
+
+double shortestPathEnumerator::countPathsFrom(const dagSide& side, int actorId,
+					      map<int, double>& counts) const
+{
+  map<int, vector<dagLink> >::const_iterator found = side.predecessors.find(actorId);
+  if (found == side.predecessors.end()) return 1; // the side's root
+  map<int, double>::iterator known = counts.find(actorId);
+  if (known != counts.end()) return known->second;
+
+  double count = 0;
+  for (int i = 0; i < (int) found->second.size(); i++)
+    count += countPathsFrom(side, found->second[i].actorId, counts);
+  return counts[actorId] = count;
+}
+
+double shortestPathEnumerator::countPaths() const
+{
+  map<int, double> sourceCounts, targetCounts;
+  double count = 0;
+  for (int i = 0; i < (int) meetings.size(); i++) {
+    count += countPathsFrom(fromSource, meetings[i], sourceCounts) *
+      countPathsFrom(fromTarget, meetings[i], targetCounts);
+  }
+  return count;
+}
+
+/**
+ * Returns the links the given digit (1 or more) chooses among: the
+ * predecessors of the actor chosen by the digit before it, except that
+ * the first digit on the target's side starts over from the meeting actor.
+ */
+
+const vector<shortestPathEnumerator::dagLink>& shortestPathEnumerator::linksAt(int digit) const
+{
+  if (digit <= sourceDepth) 
+    return fromSource.predecessors.find(actors[digit - 1])->second;
+  int from = digit == sourceDepth + 1 ? actors[0] : actors[digit - 1];
+  return fromTarget.predecessors.find(from)->second;
+}
+
+int shortestPathEnumerator::rangeAt(int digit) const
+{
+  return digit == 0 ? meetings.size() : linksAt(digit).size();
+}
+
+void shortestPathEnumerator::setDigit(int digit, int choice)
+{
+  choices[digit] = choice;
+  actors[digit] = digit == 0 ? meetings[choice] : linksAt(digit)[choice].actorId;
+}
+
+/**
+ * The choices work like an odometer whose wheels each have as many
+ * positions as the actor before them has links: the last digit that
+ * can advance does, and every digit after it starts over at zero.  No
+ * predecessor list is ever empty, so starting over always succeeds.
+ */
+
+bool shortestPathEnumerator::next(path& result)
+{
+  if (!found()) return false;
+  int digit = 0;
+  if (started) {
+    for (digit = length; digit >= 0 && choices[digit] + 1 == rangeAt(digit); digit--) ;
+    if (digit < 0) return false;
+    setDigit(digit, choices[digit] + 1);
+    digit++;
+  }
+  started = true;
+  for (; digit <= length; digit++) setDigit(digit, 0);
+
+  result = path(db.getActorName(sourceId));
+  for (int i = sourceDepth; i > 0; i--)
+    result.addConnection(db.getFilm(linksAt(i)[choices[i]].movieId), db.getActorName(actors[i - 1]));
+  for (int i = sourceDepth + 1; i <= length; i++)
+    result.addConnection(db.getFilm(linksAt(i)[choices[i]].movieId), db.getActorName(actors[i]));
+  return true;
+}
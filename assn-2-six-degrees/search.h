@@ -0,0 +1,285 @@
+#ifndef __search__
+#define __search__
+
+#include "imdb.h"
+#include "path.h"
+#include <vector>
+#include <map>
+using namespace std;
+
+class landmarkOracle;
+class degreeTable;
+
+/**
+ * Constant: kMaxPathLength
+ * ------------------------
+ * Searches give up on paths longer than this many movies.
+ */
+
+static const int kMaxPathLength = 6;
+
+/**
+ * Convenience struct: searchStats
+ * -------------------------------
+ * Counts how much of the database a search had to touch before it
+ * either found a path or gave up: the actors it reached, the films
+ * whose casts it walked, and the actors whose credits it walked.
+ */
+
+struct searchStats {
+  int actorsVisited;
+  int filmsVisited;
+  int actorsExpanded;
+  searchStats() : actorsVisited(0), filmsVisited(0), actorsExpanded(0) {}
+};
+
+/**
+ * Function type: moviePredicate
+ * -----------------------------
+ * A test a movieFilter applies to each movie a search comes across,
+ * called with the filter's auxData pointer.  Returns true if and only if
+ * the search may pass through the identified movie.
+ */
+
+typedef bool (*moviePredicate)(const imdb& db, int movieId, void *auxData);
+
+/**
+ * Convenience struct: movieFilter
+ * -------------------------------
+ * Restricts a search to the movies released from firstYear through
+ * lastYear that the predicate, if there is one, accepts.  Movies are
+ * tested as the search reaches them, so rejected movies are never
+ * expanded, and paths through them are never considered.  The year test
+ * reads imdb::getMovieYear, which is cheapest with the imdb's year table.
+ */
+
+struct movieFilter {
+  int firstYear;
+  int lastYear;
+  moviePredicate predicate;
+  void *auxData;
+  movieFilter() : firstYear(1900), lastYear(1900 + 255), predicate(NULL), auxData(NULL) {}
+
+  bool accepts(const imdb& db, int movieId) const {
+    int year = db.getMovieYear(movieId);
+    return year >= firstYear && year <= lastYear &&
+      (predicate == NULL || predicate(db, movieId, auxData));
+  }
+};
+
+/**
+ * Convenience struct: searchOptions
+ * ---------------------------------
+ * Bundles the knobs that select how findShortestPath goes about
+ * its search.  The defaults give the fastest single-threaded search
+ * we have.  Setting numThreads above 1 splits the expansion of every
+ * sizable frontier across that many threads; the path found is always
+ * the one the single-threaded search would have found.  Supplying
+ * landmarks lets the search give up at once on pairs the landmark
+ * bounds prove to be more than kMaxPathLength movies apart.
+ *
+ * Setting goalDirected replaces the breadth-first searches with an A*
+ * search that always expands the actor whose landmark lower bound on
+ * the length of a path through it is smallest (the ALT heuristic).  It
+ * still finds a path with the fewest movies, though not necessarily the
+ * same one, and usually expands far fewer actors on the way.  It needs
+ * landmarks and an imdb using the adjacency index's dense ids, and is
+ * ignored without them.
+ *
+ * Supplying degrees makes the bidirectional search expand whichever side's
+ * frontier has fewer credits in all, rather than fewer actors, since the
+ * credits are what expanding it costs.  Weighing a frontier takes a
+ * binary search per actor unless the imdb uses dense ids.
+ *
+ * Supplying a filter confines every search to the movies it accepts.
+ * The landmark lower bounds still hold for the filtered graph, so
+ * landmarks can be used alongside a filter.
+ */
+
+struct searchOptions {
+  bool bidirectional;
+  bool goalDirected;
+  int numThreads;
+  const landmarkOracle *landmarks;
+  const movieFilter *filter;
+  const degreeTable *degrees;
+  searchOptions() : bidirectional(true), goalDirected(false), numThreads(1), landmarks(NULL),
+    filter(NULL), degrees(NULL) {}
+};
+
+/**
+ * Function: findShortestPath
+ * --------------------------
+ * Finds a shortest path (measured in movies) between the two identified
+ * actors, working entirely in terms of imdb ids: actors and films
+ * already reached are tracked in flat bitmaps indexed by id, and each
+ * reached actor records the index of the actor that reached it, so
+ * names and films are only looked up for the connections that make up
+ * the final path.
+ *
+ * @param db the imdb to search.
+ * @param sourceId the id of the actor/actress the path should start with.
+ * @param targetId the id of the actor/actress the path should end with.
+ * @param options selects the search strategy.
+ * @param result updated to hold the path, if one is found.
+ * @param stats updated to record how much work the search did.
+ * @return true if and only if a path of at most kMaxPathLength movies
+ *         connects the two actors.
+ */
+
+bool findShortestPath(const imdb& db, int sourceId, int targetId,
+		      const searchOptions& options, path& result, searchStats& stats);
+
+/**
+ * Convenience struct: distanceMap
+ * -------------------------------
+ * The outcome of a breadth-first search from one actor to everyone
+ * else.  Every array is indexed by actor position, as understood by
+ * imdb::getActorIdAt, so a map means the same thing whichever ids the
+ * imdb that produced it was using.  For the actor at position i,
+ * distances[i] is the number of movies on a shortest path from the
+ * source (kUnreachable if there is no path at all), parents[i] is the
+ * position of the actor one movie closer to the source, and movies[i]
+ * is the position (as understood by imdb::getMovieIdAt) of the movie
+ * the two appeared in.  Both are -1 for the source and for unreachable
+ * actors.
+ */
+
+static const unsigned char kUnreachable = 255;
+
+struct distanceMap {
+  int sourcePosition;
+  vector<unsigned char> distances;
+  vector<int> parents;
+  vector<int> movies;
+};
+
+/**
+ * Function: computeDistances
+ * --------------------------
+ * Fills in the distance map for the identified actor with a single
+ * breadth-first search over the entire database, with no limit on the
+ * length of the paths followed.  The search splits its frontiers across
+ * options.numThreads threads and honors options.filter;
+ * options.bidirectional is ignored.
+ *
+ * @param db the imdb to search.
+ * @param sourceId the id of the actor/actress everyone's distance is measured from.
+ * @param options selects the number of threads.
+ * @param result updated to hold the distance map.
+ * @param stats updated to record how much work the search did.
+ */
+
+void computeDistances(const imdb& db, int sourceId, const searchOptions& options,
+		      distanceMap& result, searchStats& stats);
+
+/**
+ * Function: writeDistances
+ * ------------------------
+ * Writes the distance map to the named file in a compact binary form:
+ * three native ints (a magic number, the number of actors, and the
+ * source's position), then the distances as one byte per actor, padded
+ * with zeros to a multiple of four bytes, and then the parents and the
+ * movies as native ints.
+ *
+ * @return true if and only if the whole map was written.
+ */
+
+bool writeDistances(const distanceMap& map, const string& fileName);
+
+/**
+ * Class: shortestPathEnumerator
+ * -----------------------------
+ * Finds every shortest path between two actors, not just the first one
+ * a search happens upon.  The constructor runs a bidirectional search
+ * that finishes whole levels at a time, and so learns the set of actors
+ * where the two searches meet.  It then walks back from those actors to
+ * either end, building the DAG of every shortest path: each actor on
+ * one maps to its predecessor list, the (movie, actor) links one step
+ * closer to the end it was reached from.  Paths are read out of the DAG
+ * one at a time by next, without searching again, so asking for the
+ * first few of a great many paths costs next to nothing.
+ */
+
+class shortestPathEnumerator {
+ public:
+
+  /**
+   * Constructor: shortestPathEnumerator
+   * -----------------------------------
+   * Builds the DAG of shortest paths of at most kMaxPathLength movies
+   * between the two identified actors, passing only through the movies
+   * the filter accepts, if one is supplied.
+   */
+
+  shortestPathEnumerator(const imdb& db, int sourceId, int targetId,
+			 const movieFilter *filter = NULL);
+
+  /**
+   * Methods: found, getLength
+   * -------------------------
+   * Report whether any path of at most kMaxPathLength movies was found,
+   * and if so, how many movies each shortest path has.
+   */
+
+  bool found() const { return length >= 0; }
+  int getLength() const { return length; }
+
+  /**
+   * Method: countPaths
+   * ------------------
+   * Returns the number of distinct shortest paths, counting two paths as
+   * distinct if they differ in any actor or movie.  The count is a
+   * double since it can comfortably exceed the range of any integer type.
+   */
+
+  double countPaths() const;
+
+  /**
+   * Method: next
+   * ------------
+   * Sets result to the next shortest path and returns true, or returns
+   * false once every path has been handed out.  Paths come out in order
+   * of the ids along them, and no path comes out twice.
+   */
+
+  bool next(path& result);
+
+ private:
+  struct dagLink {
+    int movieId;
+    int actorId;
+  };
+
+  // one end's search: the actors at each depth (sorted by id), and the
+  // predecessor lists of the actors on shortest paths
+  struct dagSide {
+    vector<vector<int> > levels;
+    map<int, vector<dagLink> > predecessors;
+  };
+
+  void linkPredecessors(dagSide& side, int depth);
+  double countPathsFrom(const dagSide& side, int actorId, map<int, double>& counts) const;
+  const vector<dagLink>& linksAt(int digit) const;
+  int rangeAt(int digit) const;
+  void setDigit(int digit, int choice);
+
+  const imdb& db;
+  const movieFilter *filter;
+  int sourceId;
+  int length;
+  int sourceDepth;		// the meeting actors' distance from the source
+  dagSide fromSource;
+  dagSide fromTarget;
+  vector<int> meetings;
+
+  // the current path, as one choice per digit: digit 0 picks the meeting
+  // actor, digits 1 through sourceDepth pick links back towards the source,
+  // and the rest pick links on towards the target; actors[i] is the actor
+  // chosen by digit i
+  vector<int> choices;
+  vector<int> actors;
+  bool started;
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include "server.h"
+#include "path.h"
+#include "landmarks.h"
+#include <sstream>
+#include <vector>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+using namespace std;
+
+queryServer::queryServer(const imdb& db, const serverOptions& options) :
+  db(db), options(options), numQueries(0), numPathHits(0), numTreeHits(0), numSearches(0)
+{
+  pthread_mutex_init(&lock, NULL);
+}
+
+queryServer::~queryServer()
+{
+  map<int, pair<distanceMap *, list<int>::iterator> >::iterator curr;
+  for (curr = trees.begin(); curr != trees.end(); ++curr)
+    delete curr->second.first;
+  pthread_mutex_destroy(&lock);
+}
+
+/**
+ * Formats the response to a path request.
+ */
+
+static string formatPath(bool found, const path& p)
+{
+  if (!found) return "NOPATH\n";
+  ostringstream response;
+  response << "OK " << p.getLength() << endl;
+  if (p.getLength() > 0) response << p;
+  return response.str();
+}
+
+void queryServer::serve(FILE *in, FILE *out)
+{
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, in)) != -1) {
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+      line[--length] = '\0';
+    if (strcmp(line, "QUIT") == 0) break;
+    string response = answer(line);
+    if (fputs(response.c_str(), out) == EOF || fflush(out) == EOF) break;
+  }
+  free(line);
+}
+
+string queryServer::answer(const string& request)
+{
+  if (request == "STATS") return stats();
+
+  static const string kBoundsPrefix = "BOUNDS\t";
+  bool bounds = request.compare(0, kBoundsPrefix.size(), kBoundsPrefix) == 0;
+  string names = bounds ? request.substr(kBoundsPrefix.size()) : request;
+  size_t tab = names.find('\t');
+  if (tab == string::npos) return "ERROR expected two tab-separated names\n";
+  string source = names.substr(0, tab);
+  string target = names.substr(tab + 1);
+  int sourceId = db.getActorId(source);
+  if (sourceId == imdb::kNoSuchId) return "UNKNOWN " + source + "\n";
+  int targetId = db.getActorId(target);
+  if (targetId == imdb::kNoSuchId) return "UNKNOWN " + target + "\n";
+  return bounds ? answerBounds(sourceId, targetId) : answerPath(sourceId, targetId);
+}
+
+/**
+ * Formats one bound for a bounds response.
+ */
+
+static string formatBound(int bound)
+{
+  if (bound == landmarkOracle::kInfinite) return "inf";
+  ostringstream formatted;
+  formatted << bound;
+  return formatted.str();
+}
+
+string queryServer::answerBounds(int sourceId, int targetId)
+{
+  if (options.search.landmarks == NULL) return "ERROR no landmarks are loaded\n";
+  int lower, upper;
+  options.search.landmarks->getBounds(sourceId, targetId, lower, upper);
+  return "BOUNDS " + formatBound(lower) + " " + formatBound(upper) + "\n";
+}
+
+string queryServer::stats()
+{
+  ostringstream response;
+  pthread_mutex_lock(&lock);
+  response << "STATS queries " << numQueries << " path-cache-hits " << numPathHits
+	   << " tree-hits " << numTreeHits << " searches " << numSearches
+	   << " cached-paths " << paths.size() << " cached-trees " << trees.size();
+  cacheStats actors, movies;
+  if (db.getCacheStats(actors, movies))
+    response << " block-cache-hits " << actors.hits + movies.hits
+	     << " block-cache-misses " << actors.misses + movies.misses;
+  response << endl;
+  pthread_mutex_unlock(&lock);
+  return response.str();
+}
+
+/**
+ * Answers from the caches wherever possible.  Otherwise, computes the
+ * tree for any endpoint that has just become popular (and answers from
+ * that), or, failing that, searches.  The lock is never held while a
+ * tree is computed or a search runs, so other queries carry on meanwhile.
+ */
+
+string queryServer::answerPath(int sourceId, int targetId)
+{
+  query q(sourceId, targetId);
+  string response;
+  pthread_mutex_lock(&lock);
+  numQueries++;
+  bool cached = findCachedPath(q, response);
+  if (cached) {
+    numPathHits++;
+  } else if (answerFromTree(sourceId, targetId, response)) {
+    numTreeHits++;
+    cachePath(q, response);
+    cached = true;
+  }
+  bool buildSourceTree = !cached && shouldBuildTree(sourceId);
+  bool buildTargetTree = !cached && !buildSourceTree && shouldBuildTree(targetId);
+  pthread_mutex_unlock(&lock);
+  if (cached) return response;
+
+  if (buildSourceTree || buildTargetTree) {
+    buildTree(buildSourceTree ? sourceId : targetId);
+    pthread_mutex_lock(&lock);
+    if (answerFromTree(sourceId, targetId, response)) {
+      numTreeHits++;
+      cachePath(q, response);
+      cached = true;
+    }
+    pthread_mutex_unlock(&lock);
+    if (cached) return response;
+  }
+
+  path result(db.getActorName(sourceId));
+  searchStats searched;
+  bool found = sourceId == targetId || 
+    findShortestPath(db, sourceId, targetId, options.search, result, searched);
+  response = formatPath(found, result);
+
+  pthread_mutex_lock(&lock);
+  numSearches++;
+  cachePath(q, response);
+  pthread_mutex_unlock(&lock);
+  return response;
+}
+
+bool queryServer::findCachedPath(const query& q, string& response)
+{
+  map<query, pair<string, list<query>::iterator> >::iterator found = paths.find(q);
+  if (found == paths.end()) return false;
+  pathOrder.splice(pathOrder.begin(), pathOrder, found->second.second);
+  response = found->second.first;
+  return true;
+}
+
+void queryServer::cachePath(const query& q, const string& response)
+{
+  if (options.pathCacheSize <= 0 || paths.find(q) != paths.end()) return;
+  pathOrder.push_front(q);
+  paths[q] = make_pair(response, pathOrder.begin());
+  if ((int) paths.size() > options.pathCacheSize) {
+    paths.erase(pathOrder.back());
+    pathOrder.pop_back();
+  }
+}
+
+distanceMap *queryServer::findTree(int actorId)
+{
+  map<int, pair<distanceMap *, list<int>::iterator> >::iterator found = trees.find(actorId);
+  if (found == trees.end()) return NULL;
+  treeOrder.splice(treeOrder.begin(), treeOrder, found->second.second);
+  return found->second.first;
+}
+
+void queryServer::cacheTree(int actorId, distanceMap *tree)
+{
+  treeOrder.push_front(actorId);
+  trees[actorId] = make_pair(tree, treeOrder.begin());
+  if ((int) trees.size() > options.treeCacheSize) {
+    delete trees[treeOrder.back()].first;
+    trees.erase(treeOrder.back());
+    treeOrder.pop_back();
+  }
+}
+
+bool queryServer::answerFromTree(int sourceId, int targetId, string& response)
+{
+  distanceMap *tree = findTree(sourceId);
+  if (tree != NULL) {
+    response = pathFromTree(*tree, sourceId, targetId, true);
+    return true;
+  }
+
+  tree = findTree(targetId);
+  if (tree != NULL) {
+    response = pathFromTree(*tree, sourceId, targetId, false);
+    return true;
+  }
+  
+  return false;
+}
+
+/**
+ * Counts another query naming the identified actor, and returns true if
+ * that makes the actor popular enough that its tree should be built (in
+ * which case the caller is expected to build it).
+ */
+
+bool queryServer::shouldBuildTree(int actorId)
+{
+  if (options.treeCacheSize <= 0) return false;
+  int& count = popularity[actorId];
+  if (++count < options.popularThreshold) return false;
+  if (treesUnderConstruction.count(actorId) > 0 || trees.count(actorId) > 0) return false;
+  treesUnderConstruction.insert(actorId);
+  return true;
+}
+
+void queryServer::buildTree(int actorId)
+{
+  distanceMap *tree = new distanceMap;
+  searchStats searched;
+  computeDistances(db, actorId, options.search, *tree, searched);
+  
+  pthread_mutex_lock(&lock);
+  treesUnderConstruction.erase(actorId);
+  popularity.erase(actorId);
+  cacheTree(actorId, tree);
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Reads the path between the two actors off the tree, which is rooted at
+ * the source if treeAtSource is true and at the target otherwise.
+ */
+
+string queryServer::pathFromTree(const distanceMap& tree, int sourceId, int targetId,
+				 bool treeAtSource)
+{
+  int leaf = db.getActorPosition(treeAtSource ? targetId : sourceId);
+  if (tree.distances[leaf] == kUnreachable || tree.distances[leaf] > kMaxPathLength)
+    return formatPath(false, path(""));
+
+  vector<int> chain; // leaf first, root last
+  for (int position = leaf; position != -1; position = tree.parents[position])
+    chain.push_back(position);
+
+  path result(db.getActorName(sourceId));
+  int numLinks = chain.size() - 1;
+  for (int i = 0; i < numLinks; i++) {
+    int link = treeAtSource ? chain[numLinks - 1 - i] : chain[i];
+    int next = treeAtSource ? link : chain[i + 1];
+    result.addConnection(db.getFilm(db.getMovieIdAt(tree.movies[link])),
+			 db.getActorName(db.getActorIdAt(next)));
+  }
+  return formatPath(true, result);
+}
+
+/**
+ * Convenience struct: connectionTask
+ * ----------------------------------
+ * Handed to each connection's thread: the server and the connected socket.
+ */
+
+struct connectionTask {
+  queryServer *server;
+  int fd;
+};
+
+static void *serveConnection(void *data)
+{
+  connectionTask *task = (connectionTask *) data;
+  FILE *in = fdopen(task->fd, "r");
+  FILE *out = fdopen(dup(task->fd), "w");
+  if (in != NULL && out != NULL) task->server->serve(in, out);
+  if (in != NULL) fclose(in);
+  if (out != NULL) fclose(out);
+  delete task;
+  return NULL;
+}
+
+bool queryServer::listen(const string& socketPath)
+{
+  struct sockaddr_un address;
+  if (socketPath.size() >= sizeof(address.sun_path)) return false;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socketPath.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener == -1) return false;
+  unlink(socketPath.c_str());
+  if (bind(listener, (struct sockaddr *) &address, sizeof(address)) == -1 ||
+      ::listen(listener, SOMAXCONN) == -1) {
+    close(listener);
+    return false;
+  }
+
+  signal(SIGPIPE, SIG_IGN); // a client hanging up early shouldn't kill the server
+  while (true) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd == -1) continue;
+    connectionTask *task = new connectionTask;
+    task->server = this;
+    task->fd = fd;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serveConnection, task) != 0) {
+      close(fd);
+      delete task;
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
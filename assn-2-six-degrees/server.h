@@ -0,0 +1,126 @@
+#ifndef __server__
+#define __server__
+
+#include "imdb.h"
+#include "search.h"
+#include <stdio.h>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <pthread.h>
+using namespace std;
+
+/**
+ * Convenience struct: serverOptions
+ * ---------------------------------
+ * Sizes the query server's caches and selects how it searches.
+ *
+ *     pathCacheSize:    how many answered queries are remembered.
+ *     treeCacheSize:    how many popular actors' complete shortest-path
+ *                       trees (see computeDistances) are kept.
+ *     popularThreshold: how many queries must name an actor before its
+ *                       tree is computed and cached.
+ *     search:           the options every uncached search runs with.
+ */
+
+struct serverOptions {
+  int pathCacheSize;
+  int treeCacheSize;
+  int popularThreshold;
+  searchOptions search;
+  serverOptions() : pathCacheSize(10000), treeCacheSize(4), popularThreshold(8) {}
+};
+
+/**
+ * Class: queryServer
+ * ------------------
+ * A long-running six-degrees service that keeps one imdb mapped and
+ * answers shortest-path queries over a simple line protocol.  Each
+ * request is a single line:
+ *
+ *     <actor>\t<actor>   asks for a shortest path between the two.
+ *     BOUNDS\t<actor>\t<actor>
+ *                        asks for the landmark bounds on their distance
+ *                        (when the search options supply landmarks).
+ *     STATS              asks for the server's counters (including the imdb's
+ *                        block cache hits and misses, when it reads through one).
+ *     QUIT               ends the conversation.
+ *
+ * A path request is answered with "OK <n>" and then the n lines of
+ * the path as formatted by operator<<, with "NOPATH" if there's no path
+ * of at most kMaxPathLength movies, or with "UNKNOWN <name>" if one of
+ * the actors isn't in the database.  A bounds request is answered with
+ * "BOUNDS <lower> <upper>", where either bound may be "inf".  Anything
+ * else earns "ERROR <reason>".
+ *
+ * Recently answered queries are kept in an LRU cache, so repeats are
+ * answered without searching.  Actors named in many queries get their
+ * complete shortest-path tree computed once and kept in a second LRU
+ * cache, after which any query with that actor at either end is answered
+ * by walking the tree.  Paths read off a tree are shortest paths, but
+ * needn't be the same shortest path the search would have found.
+ */
+
+class queryServer {
+ public:
+  queryServer(const imdb& db, const serverOptions& options);
+  ~queryServer();
+
+  /**
+   * Method: serve
+   * -------------
+   * Answers requests read from in, writing the responses to out, until
+   * in runs dry or a QUIT request arrives.  Any number of threads may
+   * serve different streams at once.
+   */
+
+  void serve(FILE *in, FILE *out);
+
+  /**
+   * Method: listen
+   * --------------
+   * Listens on a Unix domain socket created at socketPath (replacing
+   * anything already there) and serves every connection on its own
+   * thread.  Only returns, with false, if the socket can't be set up.
+   */
+
+  bool listen(const string& socketPath);
+
+ private:
+  const imdb& db;
+  serverOptions options;
+  pthread_mutex_t lock; // guards everything below
+
+  typedef pair<int, int> query;
+  list<query> pathOrder;  // most recently used first
+  map<query, pair<string, list<query>::iterator> > paths;
+
+  list<int> treeOrder;
+  map<int, pair<distanceMap *, list<int>::iterator> > trees;
+  map<int, int> popularity;
+  set<int> treesUnderConstruction;
+
+  long long numQueries;
+  long long numPathHits;
+  long long numTreeHits;
+  long long numSearches;
+
+  string answer(const string& request);
+  string answerPath(int sourceId, int targetId);
+  string answerBounds(int sourceId, int targetId);
+  string stats();
+  bool findCachedPath(const query& q, string& response);
+  void cachePath(const query& q, const string& response);
+  distanceMap *findTree(int actorId);
+  void cacheTree(int actorId, distanceMap *tree);
+  bool answerFromTree(int sourceId, int targetId, string& response);
+  bool shouldBuildTree(int actorId);
+  void buildTree(int actorId);
+  string pathFromTree(const distanceMap& tree, int sourceId, int targetId, bool treeAtSource);
+
+  queryServer(const queryServer& original);
+  queryServer& operator=(const queryServer& rhs);
+};
+
+#endif
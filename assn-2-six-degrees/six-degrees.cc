@@ -4,8 +4,17 @@
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <sys/time.h>
 #include "imdb.h"
 #include "path.h"
+#include "search.h"
+#include "batch.h"
+#include "server.h"
+#include "landmarks.h"
+#include "degrees.h"
+#include <fstream>
+#include <unistd.h>
 using namespace std;
 
 /**
@@ -30,8 +39,7 @@ static string promptForActor(const string& prompt, const imdb& db)
     cout << prompt << " [or <enter> to quit]: ";
     getline(cin, response);
     if (response == "") return "";
-    vector<film> credits;
-    if (db.getCredits(response, credits)) return response;
+    if (db.getActorId(response) != imdb::kNoSuchId) return response;
     cout << "We couldn't find \"" << response << "\" in the movie database. "
 	 << "Please try again." << endl;
   }
@@ -58,12 +66,14 @@ static bool isNewActor(const string& actor, set<string>& previouslySeenActors)
 }
 
 /*
- * Generates the shortest path between two actors given their names and
- * an imdb database containing movie/actor records. Prints the shortest path
- * or prints an appropriate message if a path cannot be found.
+ * Breadth-first search outward from the source until the target is found.
+ * Populates result with the shortest path and returns true, or returns
+ * false if no path of at most kMaxPathLength movies exists.  This and the
+ * bidirectional search below key everything by name, and are kept as the
+ * reference implementations for the id-based searches in search.cc.
  */
-void generateShortestPath(const string source, const string target,
-  const imdb& db)
+static bool findShortestPathByName(const string& source, const string& target,
+  const imdb& db, path& result, searchStats& stats)
 {
   list<path> partialPaths; // functions as a queue
   set<string> previouslySeenActors;
@@ -71,10 +81,13 @@ void generateShortestPath(const string source, const string target,
 
   path initialPath(source);
   partialPaths.push_back(initialPath);
-  while (!partialPaths.empty() && partialPaths.front().getLength() < 6) {
+  bool found = false;
+  while (!found && !partialPaths.empty() && 
+         partialPaths.front().getLength() < kMaxPathLength) {
     // pull the first element off of the queue of paths
     path currPath = partialPaths.front();
     partialPaths.pop_front(); 
+    stats.actorsExpanded++;
     
     // get the last actors movies
     string lastActor = currPath.getLastPlayer();    
@@ -82,21 +95,22 @@ void generateShortestPath(const string source, const string target,
     db.getCredits(lastActor, films);
     
     // iterate over all the previously unseen movies
-    for (int i = 0; i < films.size(); i++) {
+    for (int i = 0; !found && i < (int) films.size(); i++) {
       if (isNewFilm(films[i], previouslySeenFilms)) {
         // look up the movies cast
         vector<string> cast;
         db.getCast(films[i], cast);
         
         // iterate over all the previously unseen actors
-        for (int j = 0; j < cast.size(); j++) {
+        for (int j = 0; j < (int) cast.size(); j++) {
           if (isNewActor(cast[j], previouslySeenActors)) {
             path newPath = currPath;
             newPath.addConnection(films[i], cast[j]);
 
             if (cast[j] == target) {
-              newPath.print();
-              return;
+              result = newPath;
+              found = true;
+              break;
             } else {
              partialPaths.push_back(newPath);
             } 
@@ -105,32 +119,663 @@ void generateShortestPath(const string source, const string target,
       }
     }   
   }
-  cout << endl << "No path between those two people could be found." << endl << endl;
+
+  stats.actorsVisited = previouslySeenActors.size();
+  stats.filmsVisited = previouslySeenFilms.size();
+  return found;
+}
+
+/**
+ * Convenience struct: nameSearchSide
+ * ----------------------------------
+ * One half of a bidirectional search.  Every actor reached from the root
+ * maps to the film and the neighboring actor (one step closer to the root)
+ * that reached it, so a path can be recovered by walking back to the root.
+ * The root maps to itself.
+ */
+struct nameSearchSide {
+  struct link {
+    film movie;
+    string neighbor;
+  };
+
+  string root;
+  map<string, link> reachedActors;
+  set<film> expandedFilms;
+  vector<string> frontier;
+  int depth;
+  int actorsExpanded;
+
+  nameSearchSide(const string& root) : root(root), depth(0), actorsExpanded(0) {
+    reachedActors[root].neighbor = root;
+    frontier.push_back(root);
+  }
+};
+
+/*
+ * Expands every actor in the side's frontier by one movie, replacing the
+ * frontier with the newly reached actors.  Stops and returns true as soon
+ * as an actor already reached by the other side turns up, recording that
+ * actor in meetingPoint.  Because whole levels are expanded at a time, the
+ * first meeting found is on a shortest path.
+ */
+static bool expandFrontier(nameSearchSide& side, const nameSearchSide& other,
+  const imdb& db, string& meetingPoint)
+{
+  vector<string> nextFrontier;
+  for (int i = 0; i < (int) side.frontier.size(); i++) {
+    const string& actor = side.frontier[i];
+    side.actorsExpanded++;
+    vector<film> films;
+    db.getCredits(actor, films);
+
+    for (int j = 0; j < (int) films.size(); j++) {
+      if (!isNewFilm(films[j], side.expandedFilms)) continue;
+      vector<string> cast;
+      db.getCast(films[j], cast);
+
+      for (int k = 0; k < (int) cast.size(); k++) {
+        if (side.reachedActors.find(cast[k]) != side.reachedActors.end()) continue;
+        nameSearchSide::link& l = side.reachedActors[cast[k]];
+        l.movie = films[j];
+        l.neighbor = actor;
+        if (other.reachedActors.find(cast[k]) != other.reachedActors.end()) {
+          meetingPoint = cast[k];
+          return true;
+        }
+        nextFrontier.push_back(cast[k]);
+      }
+    }
+  }
+
+  side.frontier.swap(nextFrontier);
+  side.depth++;
+  return false;
+}
+
+/*
+ * Searches from both ends at once, always expanding whichever frontier
+ * is smaller, until the two searches meet.  Visits far fewer actors than
+ * the unidirectional search whenever the two actors are more than a
+ * couple of movies apart.  Populates result and returns true if a path
+ * of at most kMaxPathLength movies exists, and returns false otherwise.
+ */
+static bool findShortestPathBidirectionalByName(const string& source, const string& target,
+  const imdb& db, path& result, searchStats& stats)
+{
+  nameSearchSide forward(source);
+  nameSearchSide backward(target);
+  string meetingPoint;
+  bool found = false;
+
+  while (!found && !forward.frontier.empty() && !backward.frontier.empty() &&
+         forward.depth + backward.depth < kMaxPathLength) {
+    if (forward.frontier.size() <= backward.frontier.size()) {
+      found = expandFrontier(forward, backward, db, meetingPoint);
+    } else {
+      found = expandFrontier(backward, forward, db, meetingPoint);
+    }
+  }
+
+  stats.actorsVisited = forward.reachedActors.size() + backward.reachedActors.size();
+  stats.filmsVisited = forward.expandedFilms.size() + backward.expandedFilms.size();
+  stats.actorsExpanded = forward.actorsExpanded + backward.actorsExpanded;
+  if (!found) return false;
+
+  // walk from the meeting point back to the source, then rebuild the path forwards
+  vector<const nameSearchSide::link *> firstHalf;
+  for (string actor = meetingPoint; actor != source; ) {
+    const nameSearchSide::link& l = forward.reachedActors.find(actor)->second;
+    firstHalf.push_back(&l);
+    actor = l.neighbor;
+  }
+
+  result = path(source);
+  for (int i = firstHalf.size() - 1; i >= 0; i--) {
+    const string& player = (i == 0) ? meetingPoint : firstHalf[i - 1]->neighbor;
+    result.addConnection(firstHalf[i]->movie, player);
+  }
+
+  // the backward links already point towards the target
+  for (string actor = meetingPoint; actor != target; ) {
+    const nameSearchSide::link& l = backward.reachedActors.find(actor)->second;
+    result.addConnection(l.movie, l.neighbor);
+    actor = l.neighbor;
+  }
+
+  return true;
+}
+
+/*
+ * Runs the search selected by the options (or the equivalent search keyed
+ * by name, if byName is true) between the two actors.
+ */
+static bool runSearch(const string& source, const string& target, const imdb& db,
+  const searchOptions& options, bool byName, path& result, searchStats& stats)
+{
+  if (byName) {
+    return options.bidirectional ?
+      findShortestPathBidirectionalByName(source, target, db, result, stats) :
+      findShortestPathByName(source, target, db, result, stats);
+  }
+  
+  return findShortestPath(db, db.getActorId(source), db.getActorId(target), 
+                          options, result, stats);
+}
+
+/*
+ * Generates the shortest path between two actors given their names and
+ * an imdb database containing movie/actor records. Prints the shortest path
+ * or prints an appropriate message if a path cannot be found.
+ */
+void generateShortestPath(const string source, const string target,
+  const imdb& db, const searchOptions& options, bool byName)
+{
+  path shortestPath(source);
+  searchStats stats;
+  if (runSearch(source, target, db, options, byName, shortestPath, stats)) {
+    shortestPath.print();
+  } else {
+    cout << endl << "No path between those two people could be found." << endl << endl;
+  }
+}
+
+/**
+ * Prints the bounds the landmarks put on the number of movies separating
+ * the two actors.
+ */
+static void printBounds(const string& source, const string& target, const imdb& db,
+  const landmarkOracle& landmarks)
+{
+  int lower, upper;
+  landmarks.getBounds(db.getActorId(source), db.getActorId(target), lower, upper);
+  if (lower == landmarkOracle::kInfinite) {
+    cout << "The landmarks show there's no path between those two people." << endl;
+  } else if (upper == landmarkOracle::kInfinite) {
+    cout << "The landmarks put them at least " << lower << " movie(s) apart." << endl;
+  } else {
+    cout << "The landmarks put them between " << lower << " and " << upper << " movies apart." << endl;
+  }
+}
+
+/**
+ * Returns the number of milliseconds elapsed since the specified start time.
+ */
+static double millisecondsSince(const struct timeval& start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_usec - start.tv_usec) / 1000.0;
+}
+
+/**
+ * Prints one line of compareSearches's table: how many actors the search
+ * reached and expanded, how many films it walked, how long it took, and
+ * how long a path it found.
+ */
+static void reportSearch(const char *name, const searchStats& stats, double milliseconds,
+  bool found, const path& result)
+{
+  cout << setw(16) << name << setw(9) << stats.actorsVisited << " actors, "
+       << setw(9) << stats.actorsExpanded << " expanded, "
+       << setw(8) << stats.filmsVisited << " films, " << fixed << setprecision(2) 
+       << setw(10) << milliseconds << " ms, " 
+       << (found ? result.getLength() : -1) << " movies" << endl;
+}
+
+/**
+ * Runs both the unidirectional and the bidirectional searches between the
+ * two actors (and the goal-directed search too, if the landmarks and
+ * dense ids it needs are available), prints the path found by the
+ * bidirectional search, and then reports how much work each search did.
+ */
+static void compareSearches(const string& source, const string& target,
+  const imdb& db, const searchOptions& options, bool byName)
+{
+  searchOptions uniOptions = options, biOptions = options, goalOptions = options;
+  uniOptions.bidirectional = uniOptions.goalDirected = false;
+  biOptions.bidirectional = true;
+  biOptions.goalDirected = false;
+  goalOptions.goalDirected = true;
+  bool compareGoal = !byName && options.landmarks != NULL && db.hasDenseIds();
+  path uniPath(source), biPath(source), goalPath(source);
+  searchStats uniStats, biStats, goalStats;
+  struct timeval start;
+
+  gettimeofday(&start, NULL);
+  bool uniFound = runSearch(source, target, db, uniOptions, byName, uniPath, uniStats);
+  double uniTime = millisecondsSince(start);
+  
+  gettimeofday(&start, NULL);
+  bool biFound = runSearch(source, target, db, biOptions, byName, biPath, biStats);
+  double biTime = millisecondsSince(start);
+
+  bool goalFound = false;
+  double goalTime = 0;
+  if (compareGoal) {
+    gettimeofday(&start, NULL);
+    goalFound = runSearch(source, target, db, goalOptions, byName, goalPath, goalStats);
+    goalTime = millisecondsSince(start);
+  }
+
+  if (biFound) {
+    biPath.print();
+  } else {
+    cout << endl << "No path between those two people could be found." << endl << endl;
+  }
+
+  reportSearch("unidirectional:", uniStats, uniTime, uniFound, uniPath);
+  reportSearch("bidirectional:", biStats, biTime, biFound, biPath);
+  if (compareGoal) reportSearch("goal-directed:", goalStats, goalTime, goalFound, goalPath);
+  if (uniFound != biFound || (uniFound && uniPath.getLength() != biPath.getLength()) ||
+      (compareGoal && (goalFound != biFound || 
+                       (goalFound && goalPath.getLength() != biPath.getLength()))))
+    cout << "The searches disagree!" << endl;
+}
+
+/**
+ * Lists the shortest paths between the two actors, all of them if
+ * maxPaths is negative and at most maxPaths of them otherwise, each
+ * formatted by operator<< and numbered.
+ */
+static void listShortestPaths(const string& source, const string& target,
+  const imdb& db, const searchOptions& options, int maxPaths)
+{
+  shortestPathEnumerator paths(db, db.getActorId(source), db.getActorId(target), options.filter);
+  if (!paths.found()) {
+    cout << endl << "No path between those two people could be found." << endl << endl;
+    return;
+  }
+
+  double numPaths = paths.countPaths();
+  cout << endl << fixed << setprecision(0) << numPaths << " shortest path(s) of "
+       << paths.getLength() << " movie(s)";
+  if (maxPaths >= 0 && maxPaths < numPaths) cout << ", the first " << maxPaths << " of them";
+  cout << ":" << endl;
+  path next(source);
+  for (int i = 1; (maxPaths < 0 || i <= maxPaths) && paths.next(next); i++)
+    cout << endl << "#" << i << endl << next;
+  cout << endl;
+}
+
+/**
+ * The movieFilter predicate behind --exclude-title: looks the movie up in
+ * the table of excluded movies built by excludeTitles.
+ */
+static bool isNotExcluded(const imdb& db, int movieId, void *auxData)
+{
+  const vector<bool>& excluded = *(const vector<bool> *) auxData;
+  return !excluded[movieId];
+}
+
+/**
+ * Marks, by movie id, every movie whose title contains the text, so
+ * searches test each movie with a lookup rather than by decoding its title.
+ */
+static void excludeTitles(const imdb& db, const string& text, vector<bool>& excluded)
+{
+  excluded.assign(db.getMovieIdLimit(), false);
+  for (int i = 0; i < db.getNumMovies(); i++) {
+    int movieId = db.getMovieIdAt(i);
+    if (db.getFilm(movieId).title.find(text) != string::npos) excluded[movieId] = true;
+  }
+}
+
+/**
+ * Prints the command line flags six-degrees understands and quits.
+ */
+static void usage(const char *program)
+{
+  cerr << "Usage: " << program << " [--unidirectional] [--compare] [--by-name]" << endl
+       << "       [--adjacency-index] [--name-index] [--movie-tree]" << endl
+       << "       [--batch <file>] [--threads <n>] [--search-threads <n>]" << endl
+       << "       [--distances-from <name> [--distances-file <file>]]" << endl
+       << "       [--prefault] [--will-need] [--random-access] [--huge-pages] [--load-report]" << endl
+       << "       [--serve <socket> [--path-cache <n>] [--tree-cache <n>] [--popular <n>]]" << endl
+       << "       [--landmarks [--bounds-only] [--goal-directed]]" << endl
+       << "       [--all-paths] [--max-paths <k>]" << endl
+       << "       [--from-year <year>] [--to-year <year>] [--exclude-title <text>]" << endl
+       << "       [--degrees] [--cache-mb <n> [--cache-block <bytes>] [--cache-report]]" << endl
+       << "       [data-directory]" << endl;
+  exit(1);
+}
+
+/**
+ * Answers every query in the named batch file (or on standard input, if
+ * the name is "-"), writing the results to standard output and the
+ * latency statistics to standard error.
+ */
+static void runBatchFile(const char *batchFile, const imdb& db, int numThreads,
+  const searchOptions& options)
+{
+  if (strcmp(batchFile, "-") == 0) {
+    runBatch(db, cin, cout, cerr, numThreads, options);
+    return;
+  }
+
+  ifstream in(batchFile);
+  if (!in) {
+    cerr << "Couldn't open \"" << batchFile << "\" for reading." << endl;
+    exit(1);
+  }
+  runBatch(db, in, cout, cerr, numThreads, options);
+}
+
+/**
+ * Lists how long each step of loading the imdb took (and whether any
+ * of the kernel advice was turned down) on standard error.
+ */
+static void reportLoadSteps(const imdb& db)
+{
+  const vector<loadStep>& steps = db.getLoadSteps();
+  for (int i = 0; i < (int) steps.size(); i++) {
+    cerr << fixed << setprecision(3) << setw(10) << steps[i].milliseconds << " ms  " 
+	 << steps[i].description;
+    if (!steps[i].succeeded) cerr << " (failed)";
+    cerr << endl;
+  }
+}
+
+/**
+ * Prints the counters of the block caches the data files are read
+ * through, if they are, so the budget can be sized by the hit rates.
+ */
+
+static void reportCacheStats(const imdb& db)
+{
+  cacheStats files[2];
+  if (!db.getCacheStats(files[0], files[1])) return;
+  const char *names[2] = { "actor", "movie" };
+  for (int i = 0; i < 2; i++) {
+    cerr << names[i] << " cache: " << files[i].hits << " hits, " << files[i].misses << " misses ("
+	 << fixed << setprecision(1) << 100 * files[i].hitRate() << "% hit rate), "
+	 << files[i].evictions << " evictions, " << files[i].bytesRead << " bytes read, "
+	 << files[i].blocksCached << " of " << files[i].blockCapacity << " blocks in use" << endl;
+  }
+}
+
+/**
+ * Runs one breadth-first search from the named actor or actress out to
+ * everyone else, prints how many people lie at each distance along with
+ * the source's eccentricity and mean distance, and, if distancesFile isn't
+ * NULL, writes the full distance map there.
+ */
+static void tabulateDistances(const string& source, const char *distancesFile,
+  const imdb& db, const searchOptions& options)
+{
+  int sourceId = db.getActorId(source);
+  if (sourceId == imdb::kNoSuchId) {
+    cerr << "We couldn't find \"" << source << "\" in the movie database." << endl;
+    exit(1);
+  }
+
+  distanceMap distances;
+  searchStats stats;
+  computeDistances(db, sourceId, options, distances, stats);
+
+  vector<int> counts(kUnreachable + 1, 0);
+  for (int i = 0; i < (int) distances.distances.size(); i++)
+    counts[distances.distances[i]]++;
+
+  int eccentricity = 0;
+  long long totalDistance = 0;
+  cout << "Distances from " << source << ":" << endl;
+  for (int d = 0; d < kUnreachable; d++) {
+    if (counts[d] == 0) continue;
+    cout << setw(12) << d << setw(10) << counts[d] << endl;
+    eccentricity = d;
+    totalDistance += (long long) d * counts[d];
+  }
+  cout << setw(12) << "unreachable" << setw(10) << counts[kUnreachable] << endl;
+  cout << "eccentricity " << eccentricity << ", mean distance " << fixed << setprecision(3)
+       << (double) totalDistance / (stats.actorsVisited) << " over " << stats.actorsVisited
+       << " reachable people and " << stats.filmsVisited << " films" << endl;
+
+  if (distancesFile != NULL && !writeDistances(distances, distancesFile)) {
+    cerr << "Couldn't write the distance map to \"" << distancesFile << "\"." << endl;
+    exit(1);
+  }
 }
 
 /**
  * Serves as the main entry point for the six-degrees executable.
- * There are no parameters to speak of.
  *
  * @param argc the number of tokens passed to the command line to
- *             invoke this executable.  It's completely ignored
- *             here, because we don't expect any arguments.
+ *             invoke this executable.
  * @param argv the C strings making up the full command line.
  *             We expect argv[0] to be logically equivalent to
  *             "six-degrees" (or whatever absolute path was used to
- *             invoke the program), but otherwise these are ignored
- *             as well.
+ *             invoke the program).  Any of the following flags may
+ *             follow, along with an optional path to the data directory:
+ *
+ *                 --unidirectional   search outward from the first actor only
+ *                 --compare          run both searches and report the work each did
+ *                 --by-name          key the search by actor names and films rather than ids
+ *                 --adjacency-index  follow connections through the index built by imdb-index
+ *                 --name-index       look up actors through the name index built by imdb-index
+ *                 --movie-tree       look up films through an Eytzinger-ordered search tree
+ *                 --batch <file>     answer every tab-separated pair of names in the file
+ *                                    (or on standard input, if the file is -) and quit
+ *                 --threads <n>      the number of worker threads a batch uses
+ *                                    (by default, one per online processor)
+ *                 --search-threads <n>  the number of threads each search splits
+ *                                    its frontiers across (by default, 1)
+ *                 --distances-from <name>  tabulate everyone's distance from the
+ *                                    named actor or actress and quit
+ *                 --distances-file <file>  also write the full distance map to the file
+ *                 --prefault         map the data with MAP_POPULATE
+ *                 --will-need        advise the kernel to read the data in ahead of time
+ *                 --random-access    advise the kernel to skip readahead
+ *                 --huge-pages       advise the kernel to use transparent huge pages
+ *                 --load-report      report how long each step of loading the imdb took
+ *                 --serve <socket>   answer queries over a line protocol (see server.h) on a
+ *                                    Unix socket at the given path (or on standard input
+ *                                    and output, if the path is -) instead of prompting
+ *                 --path-cache <n>   the number of answered queries the server remembers
+ *                 --tree-cache <n>   the number of popular actors' trees the server keeps
+ *                 --popular <n>      the number of queries that make an actor popular
+ *                 --landmarks        load the landmark distances built by imdb-index, report
+ *                                    the bounds they put on each query, and use them to skip
+ *                                    searches for pairs they show to be too far apart
+ *                 --bounds-only      just report the landmark bounds, without searching
+ *                 --goal-directed    search with A*, guided by the landmark bounds (needs
+ *                                    --landmarks and --adjacency-index)
+ *                 --all-paths        list every shortest path between the two people
+ *                 --max-paths <k>    list just the first k of the shortest paths
+ *                 --from-year <year> only connect people through movies released in or
+ *                                    after the year
+ *                 --to-year <year>   only connect people through movies released in or
+ *                                    before the year
+ *                 --exclude-title <text>  never connect people through movies whose
+ *                                    titles contain the text (such as "(TV)")
+ *                 --degrees          load the degree file built by imdb-index, and have the
+ *                                    bidirectional search expand the side whose frontier
+ *                                    has fewer credits rather than fewer people
+ *                 --cache-mb <n>     read the data files through a block cache of n megabytes
+ *                                    rather than mapping them whole
+ *                 --cache-block <bytes>  the size of the blocks the cache reads
+ *                 --cache-report     report the cache's hit rates on the way out
+ *
  * @return 0 if the program ends normally, and undefined otherwise.
  */
 
 int main(int argc, const char *argv[])
 {
-  imdb db(determinePathToData(argv[1])); // inlined in imdb-utils.h
+  const char *dataPath = NULL;
+  searchOptions options;
+  bool compare = false;
+  bool byName = false;
+  imdbOptions dbOptions;
+  const char *batchFile = NULL;
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *distancesSource = NULL;
+  const char *distancesFile = NULL;
+  bool loadReport = false;
+  const char *socketPath = NULL;
+  serverOptions serveOptions;
+  bool useLandmarks = false;
+  bool boundsOnly = false;
+  int maxPaths = 0;		// 0 for one path, negative for all of them
+  movieFilter filter;
+  bool filtered = false;
+  const char *excludedText = NULL;
+  vector<bool> excludedMovies;
+  bool useDegrees = false;
+  bool cacheReport = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--unidirectional") == 0) {
+      options.bidirectional = false;
+    } else if (strcmp(argv[i], "--compare") == 0) {
+      compare = true;
+    } else if (strcmp(argv[i], "--by-name") == 0) {
+      byName = true;
+    } else if (strcmp(argv[i], "--adjacency-index") == 0) {
+      dbOptions.useAdjacencyIndex = true;
+    } else if (strcmp(argv[i], "--name-index") == 0) {
+      dbOptions.useNameIndex = true;
+    } else if (strcmp(argv[i], "--movie-tree") == 0) {
+      dbOptions.useMovieTree = true;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      if (++i == argc) usage(argv[0]);
+      batchFile = argv[i];
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      if (++i == argc || (numThreads = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--search-threads") == 0) {
+      if (++i == argc || (options.numThreads = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--distances-from") == 0) {
+      if (++i == argc) usage(argv[0]);
+      distancesSource = argv[i];
+    } else if (strcmp(argv[i], "--distances-file") == 0) {
+      if (++i == argc) usage(argv[0]);
+      distancesFile = argv[i];
+    } else if (strcmp(argv[i], "--prefault") == 0) {
+      dbOptions.prefault = true;
+    } else if (strcmp(argv[i], "--will-need") == 0) {
+      dbOptions.willNeed = true;
+    } else if (strcmp(argv[i], "--random-access") == 0) {
+      dbOptions.randomAccess = true;
+    } else if (strcmp(argv[i], "--huge-pages") == 0) {
+      dbOptions.hugePages = true;
+    } else if (strcmp(argv[i], "--load-report") == 0) {
+      loadReport = true;
+    } else if (strcmp(argv[i], "--serve") == 0) {
+      if (++i == argc) usage(argv[0]);
+      socketPath = argv[i];
+    } else if (strcmp(argv[i], "--path-cache") == 0) {
+      if (++i == argc || (serveOptions.pathCacheSize = atoi(argv[i])) < 0) usage(argv[0]);
+    } else if (strcmp(argv[i], "--tree-cache") == 0) {
+      if (++i == argc || (serveOptions.treeCacheSize = atoi(argv[i])) < 0) usage(argv[0]);
+    } else if (strcmp(argv[i], "--popular") == 0) {
+      if (++i == argc || (serveOptions.popularThreshold = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--landmarks") == 0) {
+      useLandmarks = true;
+    } else if (strcmp(argv[i], "--bounds-only") == 0) {
+      useLandmarks = boundsOnly = true;
+    } else if (strcmp(argv[i], "--all-paths") == 0) {
+      maxPaths = -1;
+    } else if (strcmp(argv[i], "--max-paths") == 0) {
+      if (++i == argc || (maxPaths = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--from-year") == 0) {
+      if (++i == argc) usage(argv[0]);
+      filter.firstYear = atoi(argv[i]);
+      filtered = dbOptions.useYearTable = true;
+    } else if (strcmp(argv[i], "--to-year") == 0) {
+      if (++i == argc) usage(argv[0]);
+      filter.lastYear = atoi(argv[i]);
+      filtered = dbOptions.useYearTable = true;
+    } else if (strcmp(argv[i], "--exclude-title") == 0) {
+      if (++i == argc) usage(argv[0]);
+      excludedText = argv[i];
+      filtered = true;
+    } else if (strcmp(argv[i], "--degrees") == 0) {
+      useDegrees = true;
+    } else if (strcmp(argv[i], "--cache-mb") == 0) {
+      if (++i == argc || atoi(argv[i]) < 1) usage(argv[0]);
+      dbOptions.cacheBudget = (size_t) atoi(argv[i]) << 20;
+    } else if (strcmp(argv[i], "--cache-block") == 0) {
+      if (++i == argc || (dbOptions.cacheBlockSize = atoi(argv[i])) < 1) usage(argv[0]);
+    } else if (strcmp(argv[i], "--cache-report") == 0) {
+      cacheReport = true;
+    } else if (strcmp(argv[i], "--goal-directed") == 0) {
+      options.goalDirected = true;
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+    } else {
+      dataPath = argv[i];
+    }
+  }
+
+  if (options.goalDirected && !(useLandmarks && dbOptions.useAdjacencyIndex)) {
+    cerr << "--goal-directed needs both --landmarks and --adjacency-index." << endl;
+    usage(argv[0]);
+  }
+
+  if (filtered && byName) {
+    cerr << "The searches keyed by name can't filter movies." << endl;
+    usage(argv[0]);
+  }
+
+  imdb db(determinePathToData(dataPath), dbOptions); // inlined in imdb-utils.h
+  if (loadReport) reportLoadSteps(db);
   if (!db.good()) {
     cout << "Failed to properly initialize the imdb database." << endl;
     cout << "Please check to make sure the source files exist and that you have permission to read them." << endl;
+    if (dbOptions.useAdjacencyIndex || dbOptions.useNameIndex) 
+      cout << "If the indices are missing or out of date, run imdb-index to rebuild them." << endl;
     exit(1);
   }
+
+  landmarkOracle landmarks(db, determinePathToData(dataPath));
+  if (useLandmarks) {
+    if (!landmarks.good()) {
+      cout << "Failed to load the landmark distances; run imdb-index to build them." << endl;
+      exit(1);
+    }
+    options.landmarks = &landmarks;
+  }
+
+  degreeTable degrees(db, determinePathToData(dataPath));
+  if (useDegrees) {
+    if (!degrees.good()) {
+      cout << "Failed to load the degree file; run imdb-index to build it." << endl;
+      exit(1);
+    }
+    options.degrees = &degrees;
+  }
+
+  if (filtered) {
+    if (excludedText != NULL) {
+      excludeTitles(db, excludedText, excludedMovies);
+      filter.predicate = isNotExcluded;
+      filter.auxData = &excludedMovies;
+    }
+    options.filter = &filter;
+  }
+
+  if (distancesSource != NULL) {
+    tabulateDistances(distancesSource, distancesFile, db, options);
+    if (cacheReport) reportCacheStats(db);
+    return 0;
+  }
+
+  if (socketPath != NULL) {
+    serveOptions.search = options;
+    queryServer server(db, serveOptions);
+    if (strcmp(socketPath, "-") == 0) {
+      server.serve(stdin, stdout);
+      if (cacheReport) reportCacheStats(db);
+      return 0;
+    }
+    server.listen(socketPath);
+    cerr << "Couldn't listen on \"" << socketPath << "\"." << endl;
+    exit(1);
+  }
+
+  if (batchFile != NULL) {
+    runBatchFile(batchFile, db, numThreads, options);
+    if (cacheReport) reportCacheStats(db);
+    return 0;
+  }
   
   while (true) {
     string source = promptForActor("Actor or actress", db);
@@ -139,12 +784,19 @@ int main(int argc, const char *argv[])
     if (target == "") break;
     if (source == target) {
       cout << "Good one.  This is only interesting if you specify two different people." << endl;
+    } else if (boundsOnly) {
+      printBounds(source, target, db, landmarks);
+    } else if (compare) {
+      compareSearches(source, target, db, options, byName);
+    } else if (maxPaths != 0) {
+      listShortestPaths(source, target, db, options, maxPaths);
     } else {
-      generateShortestPath(source, target, db);
+      if (useLandmarks) printBounds(source, target, db, landmarks);
+      generateShortestPath(source, target, db, options, byName);
     }
   }
   
   cout << "Thanks for playing!" << endl;
+  if (cacheReport) reportCacheStats(db);
   return 0;
 }
-
@@ -19,8 +19,227 @@ static vector *HashSetElemVector(const hashset *h, const void *elemAddr)
   return h->buckets + bucket;
 }
 
+// the open-addressed engine stores each slot's probe length plus one in a
+// byte (saturating at kFarFromHome, past which the length is recomputed from
+// the hash code)
+static const int kFarFromHome = 255;
+
+// unless told otherwise, a chained hashset rehashes once its buckets hold
+// four elements on average, and an open-addressed one once 7/8 of its slots
+// are full; either way, the number of buckets or slots grows to 2n + 1
+static const double kDefaultChainedMaxLoadFactor = 4.0;
+static const double kDefaultOpenMaxLoadFactor = 0.875;
+static const int kInitialBucketAllocation = 10;
+
+// Returns true if entering one more element would take the hashset past its
+// maximum load factor.
+static bool HashSetNeedsRehash(const hashset *h)
+{
+  return h->count + 1 > h->maxLoadFactor * h->numBuckets;
+}
+
+static void *HashSetSlot(const hashset *h, int slot)
+{
+  return (char *) h->slots + (size_t) slot * h->elemSize;
+}
+
+// Returns how far the element in the specified full slot sits from its home slot.
+static int OpenHashSetProbeLength(const hashset *h, int slot)
+{
+  if (h->probeLengths[slot] < kFarFromHome) return h->probeLengths[slot] - 1;
+  int home = HashSetElemBucket(h, HashSetSlot(h, slot));
+  return (slot - home + h->numBuckets) % h->numBuckets;
+}
+
+static void OpenHashSetSetProbeLength(hashset *h, int slot, int probeLength)
+{
+  h->probeLengths[slot] = probeLength + 1 < kFarFromHome ? probeLength + 1 : kFarFromHome;
+}
+
+static void OpenHashSetAllocate(hashset *h, int numSlots)
+{
+  h->numBuckets = numSlots;
+  h->probeLengths = calloc(numSlots, sizeof(unsigned char));
+  h->slots = malloc((size_t) numSlots * h->elemSize);
+  assert(h->probeLengths != NULL && h->slots != NULL);
+}
+
+static void OpenHashSetSwap(hashset *h, void *elemAddr1, void *elemAddr2)
+{
+  void *temp = (char *) h->scratch + h->elemSize;
+  memcpy(temp, elemAddr1, h->elemSize);
+  memcpy(elemAddr1, elemAddr2, h->elemSize);
+  memcpy(elemAddr2, temp, h->elemSize);
+}
+
+// Robin Hood insertion of an element known not to be present, starting at
+// the specified slot, probeLength slots on from the element's home: walks on,
+// and whenever it passes an element nearer its own home than the one being
+// carried, leaves the carried element there and carries on with the one it
+// displaced.  The carried element starts out in carried, which mustn't be one
+// of the slots, and which is overwritten along the way.  Returns the address
+// the original element ends up at.
+static void *OpenHashSetPlace(hashset *h, void *carried, int slot, int probeLength)
+{
+  void *placed = NULL;
+  for (; h->probeLengths[slot] != 0; probeLength++) {
+    int residentProbeLength = OpenHashSetProbeLength(h, slot);
+    if (residentProbeLength < probeLength) {
+      OpenHashSetSwap(h, carried, HashSetSlot(h, slot));
+      OpenHashSetSetProbeLength(h, slot, probeLength);
+      probeLength = residentProbeLength;
+      if (placed == NULL) placed = HashSetSlot(h, slot);
+    }
+    if (++slot == h->numBuckets) slot = 0;
+  }
+  memcpy(HashSetSlot(h, slot), carried, h->elemSize);
+  OpenHashSetSetProbeLength(h, slot, probeLength);
+  return placed != NULL ? placed : HashSetSlot(h, slot);
+}
+
+// Moves every element into a fresh array of numSlots slots.
+static void OpenHashSetResize(hashset *h, int numSlots)
+{
+  int oldNumSlots = h->numBuckets;
+  unsigned char *oldProbeLengths = h->probeLengths;
+  void *oldSlots = h->slots;
+  OpenHashSetAllocate(h, numSlots);
+  for (int i = 0; i < oldNumSlots; i++) {
+    if (oldProbeLengths[i] == 0) continue;
+    memcpy(h->scratch, (char *) oldSlots + (size_t) i * h->elemSize, h->elemSize);
+    OpenHashSetPlace(h, h->scratch, HashSetElemBucket(h, h->scratch), 0);
+  }
+  free(oldProbeLengths);
+  free(oldSlots);
+}
+
+// Walks the run of slots the element would be found in.  Returns the slot
+// holding its match and sets *found if there is one, and otherwise returns
+// the slot where the element belongs, setting *probeLength to how far that
+// is from its home slot.  The run ends at an empty slot, or at an element
+// nearer its home than the key would be, since insertion would have placed
+// the key before it.
+static int OpenHashSetProbe(const hashset *h, const void *elemAddr, int *probeLength, bool *found)
+{
+  int slot = HashSetElemBucket(h, elemAddr);
+  for (*probeLength = 0; h->probeLengths[slot] != 0; (*probeLength)++) {
+    if (OpenHashSetProbeLength(h, slot) < *probeLength) break;
+    if (h->comparefn(elemAddr, HashSetSlot(h, slot)) == 0) {
+      *found = true;
+      return slot;
+    }
+    if (++slot == h->numBuckets) slot = 0;
+  }
+  *found = false;
+  return slot;
+}
+
+static void *OpenHashSetLookup(const hashset *h, const void *elemAddr)
+{
+  int probeLength;
+  bool found;
+  int slot = OpenHashSetProbe(h, elemAddr, &probeLength, &found);
+  return found ? HashSetSlot(h, slot) : NULL;
+}
+
+// Inserts the element where the probe for it stopped, unless the array has
+// to grow first, in which case the probe is repeated.
+static void *OpenHashSetEnterIfAbsent(hashset *h, const void *elemAddr, bool *entered)
+{
+  int probeLength;
+  bool found;
+  int slot = OpenHashSetProbe(h, elemAddr, &probeLength, &found);
+  *entered = !found;
+  if (found) return HashSetSlot(h, slot);
+
+  if (HashSetNeedsRehash(h)) {
+    OpenHashSetResize(h, 2 * h->numBuckets + 1);
+    slot = OpenHashSetProbe(h, elemAddr, &probeLength, &found);
+  }
+  memcpy(h->scratch, elemAddr, h->elemSize);
+  h->count++;
+  return OpenHashSetPlace(h, h->scratch, slot, probeLength);
+}
+
+// Binary searches the bucket, which is kept sorted, for the element.  Returns
+// the position of its match and sets *found if there is one, and otherwise
+// returns the position the element belongs at.
+static int ChainedHashSetSearch(const hashset *h, const vector *v, const void *elemAddr, bool *found)
+{
+  int low = 0, high = VectorLength(v);
+  while (low < high) {
+    int mid = (low + high) / 2;
+    int cmp = h->comparefn(elemAddr, VectorNth(v, mid));
+    if (cmp == 0) {
+      *found = true;
+      return mid;
+    }
+    if (cmp < 0) high = mid; else low = mid + 1;
+  }
+  *found = false;
+  return low;
+}
+
+static void ChainedHashSetAllocate(hashset *h, int numBuckets)
+{
+  h->numBuckets = numBuckets;
+  h->buckets = malloc(sizeof(vector) * numBuckets);
+  assert(h->buckets != NULL);
+  for (int i = 0; i < numBuckets; i++) {
+    VectorNew(h->buckets + i, h->elemSize, h->freefn, kInitialBucketAllocation);
+  }
+}
+
+// Redistributes every element over a fresh set of numBuckets buckets, keeping
+// each of them sorted.
+static void ChainedHashSetRehash(hashset *h, int numBuckets)
+{
+  int oldNumBuckets = h->numBuckets;
+  vector *oldBuckets = h->buckets;
+  ChainedHashSetAllocate(h, numBuckets);
+  for (int i = 0; i < oldNumBuckets; i++) {
+    vector *old = oldBuckets + i;
+    for (int j = 0; j < VectorLength(old); j++) {
+      const void *elemAddr = VectorNth(old, j);
+      vector *v = HashSetElemVector(h, elemAddr);
+      bool found;
+      VectorInsert(v, elemAddr, ChainedHashSetSearch(h, v, elemAddr, &found));
+    }
+    old->freeFn = NULL; // the elements now live in the new buckets
+    VectorDispose(old);
+  }
+  free(oldBuckets);
+}
+
+// Inserts the element into its place in the sorted bucket, shifting the
+// elements after it over, rather than appending it and resorting.
+static void *ChainedHashSetEnterIfAbsent(hashset *h, const void *elemAddr, bool *entered)
+{
+  vector *v = HashSetElemVector(h, elemAddr);
+  bool found;
+  int pos = ChainedHashSetSearch(h, v, elemAddr, &found);
+  *entered = !found;
+  if (found) return VectorNth(v, pos);
+
+  if (HashSetNeedsRehash(h)) {
+    ChainedHashSetRehash(h, 2 * h->numBuckets + 1);
+    v = HashSetElemVector(h, elemAddr);
+    pos = ChainedHashSetSearch(h, v, elemAddr, &found);
+  }
+  VectorInsert(v, elemAddr, pos);
+  h->count++;
+  return VectorNth(v, pos);
+}
+
 void HashSetNew(hashset *h, int elemSize, int numBuckets,
 		HashSetHashFunction hashfn, HashSetCompareFunction comparefn, HashSetFreeFunction freefn)
+{
+  HashSetNewWithEngine(h, elemSize, numBuckets, hashfn, comparefn, freefn, HashSetChained);
+}
+
+void HashSetNewWithEngine(hashset *h, int elemSize, int numBuckets,
+			  HashSetHashFunction hashfn, HashSetCompareFunction comparefn, 
+			  HashSetFreeFunction freefn, HashSetEngine engine)
 {
   assert(elemSize > 0);
   assert(numBuckets > 0);
@@ -32,52 +251,92 @@ void HashSetNew(hashset *h, int elemSize, int numBuckets,
   h->hashfn = hashfn;
   h->comparefn = comparefn;
   h->freefn = freefn;
+  h->engine = engine;
+  h->maxLoadFactor = engine == HashSetOpenAddressed ? kDefaultOpenMaxLoadFactor : kDefaultChainedMaxLoadFactor;
+  h->count = 0;
+  h->buckets = NULL;
+  h->probeLengths = NULL;
+  h->slots = h->scratch = NULL;
 
-  h->buckets = malloc(sizeof(vector) * numBuckets);
-  for (int i = 0; i < numBuckets; i++) {
-    VectorNew(h->buckets + i, elemSize, freefn, 10);
-  }    
+  if (engine == HashSetOpenAddressed) {
+    OpenHashSetAllocate(h, numBuckets);
+    h->scratch = malloc(2 * elemSize);
+    assert(h->scratch != NULL);
+    return;
+  }
+
+  ChainedHashSetAllocate(h, numBuckets);
+}
+
+void HashSetSetMaxLoadFactor(hashset *h, double maxLoadFactor)
+{
+  assert(maxLoadFactor > 0);
+  assert(h->engine != HashSetOpenAddressed || maxLoadFactor < 1);
+  h->maxLoadFactor = maxLoadFactor;
 }
 
 void HashSetDispose(hashset *h)
 {
-  if (h->freefn != NULL) {
-    for (int i = 0; i < h->numBuckets; i++)
-      VectorDispose(h->buckets + i);
+  if (h->engine == HashSetOpenAddressed) {
+    for (int i = 0; i < h->numBuckets && h->freefn != NULL; i++)
+      if (h->probeLengths[i] != 0) h->freefn(HashSetSlot(h, i));
+    free(h->probeLengths);
+    free(h->slots);
+    free(h->scratch);
+    return;
   }
+
+  for (int i = 0; i < h->numBuckets; i++)
+    VectorDispose(h->buckets + i);
   free(h->buckets);
 }
 
 int HashSetCount(const hashset *h)
 {
-  int count = 0;
-  for (int i = 0; i < h->numBuckets; i++)
-    count += VectorLength(h->buckets + i);
-  return count;
+  return h->count;
 }
 
 void HashSetMap(hashset *h, HashSetMapFunction mapfn, void *auxData)
 {
   assert(mapfn != NULL);
+  if (h->engine == HashSetOpenAddressed) {
+    for (int i = 0; i < h->numBuckets; i++)
+      if (h->probeLengths[i] != 0) mapfn(HashSetSlot(h, i), auxData);
+    return;
+  }
   for (int i = 0; i < h->numBuckets; i++) 
     VectorMap(h->buckets + i, mapfn, auxData);
 }
 
+void *HashSetEnterIfAbsent(hashset *h, const void *elemAddr, bool *entered)
+{
+  bool ignored;
+  if (entered == NULL) entered = &ignored;
+  if (h->engine == HashSetOpenAddressed) return OpenHashSetEnterIfAbsent(h, elemAddr, entered);
+  return ChainedHashSetEnterIfAbsent(h, elemAddr, entered);
+}
+
+void *HashSetFindOrInsert(hashset *h, const void *key, HashSetInitFunction initFn, bool *inserted)
+{
+  bool entered;
+  void *elemAddr = HashSetEnterIfAbsent(h, key, &entered);
+  if (entered && initFn != NULL) initFn(elemAddr);
+  if (inserted != NULL) *inserted = entered;
+  return elemAddr;
+}
+
 void HashSetEnter(hashset *h, const void *elemAddr)
 {
-  void *existing = HashSetLookup(h, elemAddr);
-  if (existing) {
-    memcpy(existing, elemAddr, h->elemSize);
-  } else {
-    vector *v = HashSetElemVector(h, elemAddr);
-    VectorAppend(v, elemAddr);
-    VectorSort(v, h->comparefn);
-  }
+  bool entered;
+  void *stored = HashSetEnterIfAbsent(h, elemAddr, &entered);
+  if (!entered && stored != elemAddr) memcpy(stored, elemAddr, h->elemSize);
 }
 
 void *HashSetLookup(const hashset *h, const void *elemAddr)
 { 
+  if (h->engine == HashSetOpenAddressed) return OpenHashSetLookup(h, elemAddr);
   vector *v = HashSetElemVector(h, elemAddr);
-  int pos = VectorSearch(v, elemAddr, h->comparefn, 0, true);
-  return pos == -1 ? NULL : VectorNth(v, pos);
+  bool found;
+  int pos = ChainedHashSetSearch(h, v, elemAddr, &found);
+  return found ? VectorNth(v, pos) : NULL;
 }
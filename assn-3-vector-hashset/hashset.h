@@ -62,6 +62,43 @@ typedef void (*HashSetMapFunction)(void *elemAddr, void *auxData);
 
 typedef void (*HashSetFreeFunction)(void *elemAddr);
 
+/**
+ * Type: HashSetInitFunction
+ * -------------------------
+ * Class of functions designed to finish initializing an element
+ * that HashSetFindOrInsert has just copied into a hashset from
+ * a key, typically by replacing borrowed pointers with copies the
+ * hashset can own and by setting up the fields the key left out.
+ * It mustn't change anything the hash or compare functions look at.
+ */
+
+typedef void (*HashSetInitFunction)(void *elemAddr);
+
+/**
+ * Type: HashSetEngine
+ * -------------------
+ * Selects how a hashset stores its elements:
+ *
+ *   HashSetChained:       each bucket is a sorted vector of
+ *                         the elements hashing to it.  Every bucket allocates
+ *                         room for a few elements as the hashset is created.
+ *   HashSetOpenAddressed: the elements sit directly in one flat array of
+ *                         slots, each element in the first free slot at or
+ *                         after the one it hashes to, alongside a byte per
+ *                         slot recording how far each element sits from its
+ *                         own slot.  Insertions keep those distances even
+ *                         (Robin Hood hashing), so a lookup scans a short run
+ *                         of neighboring slots and stops at the first slot
+ *                         nearer its home than the key would be.  The hash
+ *                         function is called with the number of slots, which
+ *                         starts at numBuckets and grows as the array fills.
+ */
+
+typedef enum {
+  HashSetChained,
+  HashSetOpenAddressed
+} HashSetEngine;
+
 /**
  * Type: hashset
  * -------------
@@ -79,6 +116,12 @@ typedef struct {
   HashSetHashFunction hashfn;
   HashSetCompareFunction comparefn;
   HashSetFreeFunction freefn;
+  HashSetEngine engine;
+  int count;                     // the number of elements
+  double maxLoadFactor;          // count / numBuckets is kept at or below this
+  unsigned char *probeLengths;   // HashSetOpenAddressed only: each slot's distance from
+  void *slots;                   // its element's home slot, plus one (0 for empty slots),
+  void *scratch;                 // the slots themselves, and room for two elements being moved around
 } hashset;
 
 /**
@@ -94,9 +137,12 @@ typedef struct {
  * raised if this size is less than or equal to 0.
  *
  * The numBuckets parameter specifies the number of buckets that the elements
- * will be partitioned into.  Once a hashset is created, this number does
- * not change.  The numBuckets parameter must be in sync with the behavior of
- * the hashfn, which must return a hash code between 0 and numBuckets - 1.   
+ * will be partitioned into to begin with.  Whenever entering an element would
+ * leave more than four elements per bucket on average, every element is
+ * rehashed into 2 * numBuckets + 1 buckets, so the buckets stay short however
+ * many elements are entered (see HashSetSetMaxLoadFactor).  The hashfn must
+ * return a hash code between 0 and one less than the number of buckets it's
+ * passed, since that number changes over the life of the hashset.   
  * The hashfn parameter specifies the function that is called to retrieve the
  * hash code for a given element.  See the type declaration of HashSetHashFunction
  * above for more information.  An assert is raised if numBuckets is less than or
@@ -123,6 +169,39 @@ typedef struct {
 void HashSetNew(hashset *h, int elemSize, int numBuckets, 
 		HashSetHashFunction hashfn, HashSetCompareFunction comparefn, HashSetFreeFunction freefn);
 
+/**
+ * Function:  HashSetNewWithEngine
+ * -------------------------------
+ * Initializes the identified hashset just as HashSetNew does, but stores
+ * its elements as the engine parameter selects (see HashSetEngine above).
+ * HashSetNew is the same as passing HashSetChained.  Every other hashset
+ * function works the same way with either engine, except that HashSetMap
+ * visits the elements of an open-addressed hashset in a different order.
+ * For HashSetOpenAddressed, numBuckets is the number of slots to start
+ * with, and is best set to a little more than the number of elements
+ * expected; the array of slots is grown once 7/8 of them are full.
+ */
+
+void HashSetNewWithEngine(hashset *h, int elemSize, int numBuckets, 
+			  HashSetHashFunction hashfn, HashSetCompareFunction comparefn, 
+			  HashSetFreeFunction freefn, HashSetEngine engine);
+
+/**
+ * Function: HashSetSetMaxLoadFactor
+ * ---------------------------------
+ * Sets the largest number of elements per bucket (or, for an open-addressed
+ * hashset, the largest fraction of slots full) that the hashset tolerates
+ * before entering another element rehashes all of them into 2n + 1 buckets.
+ * Lower factors trade memory for shorter searches.  The defaults are 4 for
+ * HashSetChained and 0.875 for HashSetOpenAddressed.  A new factor takes
+ * effect at the next insertion, and the hashset never shrinks.
+ *
+ * An assert is raised if maxLoadFactor isn't positive, or if it isn't
+ * less than 1 for an open-addressed hashset.
+ */
+
+void HashSetSetMaxLoadFactor(hashset *h, double maxLoadFactor);
+
 /**
  * Function: HashSetDispose
  * ------------------------
@@ -145,7 +224,8 @@ void HashSetDispose(hashset *h);
  * Function: HashSetCount
  * ----------------------
  * Returns the number of elements residing in 
- * the specified hashset.
+ * the specified hashset, which is kept as they
+ * are entered, so this runs in constant time.
  */
 
 int HashSetCount(const hashset *h);
@@ -162,10 +242,47 @@ int HashSetCount(const hashset *h);
  * An assert is raised if the specified address is NULL, or
  * if the embedded hash function somehow computes a hash code
  * for the element that is out of the [0, numBuckets) range.
+ * Entering an element may move the elements already stored, so
+ * addresses returned by HashSetLookup are only good until the
+ * next insertion.
  */
 
 void HashSetEnter(hashset *h, const void *elemAddr);
 
+/**
+ * Function: HashSetEnterIfAbsent
+ * ------------------------------
+ * Inserts the specified element into the specified hashset unless
+ * an element matching it is already there, in which case the stored
+ * element is left as it is.  Either way, returns the address of the
+ * stored element, so clients that would otherwise look an element up,
+ * enter it if it's missing, and then look it up again to update it can
+ * search just once.  If entered isn't NULL, *entered is set to true if
+ * and only if the element was inserted.  The address is only good until
+ * the next insertion.
+ *
+ * An assert is raised under the same conditions as for HashSetEnter.
+ */
+
+void *HashSetEnterIfAbsent(hashset *h, const void *elemAddr, bool *entered);
+
+/**
+ * Function: HashSetFindOrInsert
+ * -----------------------------
+ * Returns the address of the element matching the key, inserting a
+ * copy of the key first if there isn't one, in which case initFn (if
+ * it isn't NULL) is called on the copy before it's returned.  The key
+ * is hashed and searched for once.  If inserted isn't NULL, *inserted
+ * is set to true if and only if the key was inserted.  The key has
+ * to be a full element, although only the fields the hash and compare
+ * functions use need be set, since initFn can fill in the rest.  The
+ * address is only good until the next insertion.
+ *
+ * An assert is raised under the same conditions as for HashSetEnter.
+ */
+
+void *HashSetFindOrInsert(hashset *h, const void *key, HashSetInitFunction initFn, bool *inserted);
+
 /**
  * Function: HashSetLookup
  * -----------------------
@@ -99,13 +99,11 @@ static void BuildTableOfLetterCounts(hashset *counts)
   while ((ch = getc(fp)) != EOF) {
     if (isalpha(ch)) { // only count letters
       localFreq.ch = tolower(ch);
-      localFreq.occurrences = 1;
+      localFreq.occurrences = 0;
   
-      // See if we already have an entry for this char		
-      found = (struct frequency *) HashSetLookup(counts, &localFreq);	
-      if (found != NULL) 		// increment if already there 
-	localFreq.occurrences = found->occurrences + 1;
-      HashSetEnter(counts, &localFreq); // enter should overwrite if needed
+      // find this char's entry, entering it with no occurrences if it's new
+      found = (struct frequency *) HashSetFindOrInsert(counts, &localFreq, NULL, NULL);
+      found->occurrences++;
     }
   }
   
@@ -135,16 +133,20 @@ static void AddFrequency(void *elem, void *v)
  * into a vector and sorts them by frequency of occurrences and 
  * prints the array out.  Note that this particular stress test passes
  * 0 as the initialAllocation, which the vector is required to handle
- * gracefully - be careful!
+ * gracefully - be careful!  Runs once per engine: the open-addressed
+ * run starts with fewer slots than there are letters, so it has to grow.
+ * A maxLoadFactor other than 0 replaces the engine's default, which
+ * lets the chained engine be made to rehash too.
  */
-static void TestHashTable(void)
+static void TestHashTable(HashSetEngine engine, double maxLoadFactor, const char *engineName)
 {
   hashset counts;
   vector sortedCounts;
   
-  HashSetNew(&counts, sizeof(struct frequency), kNumBuckets, HashFrequency, CompareLetter, NULL);
+  HashSetNewWithEngine(&counts, sizeof(struct frequency), kNumBuckets, HashFrequency, CompareLetter, NULL, engine);
+  if (maxLoadFactor > 0) HashSetSetMaxLoadFactor(&counts, maxLoadFactor);
   
-  fprintf(stdout, "\n\n ------------------------- Starting the HashTable test\n");
+  fprintf(stdout, "\n\n ------------------------- Starting the %s HashTable test\n", engineName);
   BuildTableOfLetterCounts(&counts);
   
   fprintf(stdout, "Here is the unordered contents of the table:\n");
@@ -167,7 +169,9 @@ static void TestHashTable(void)
 
 int main(int ununsed, char **alsoUnused) 
 {
-  TestHashTable();	
+  TestHashTable(HashSetChained, 0, "chained");
+  TestHashTable(HashSetChained, 0.5, "rehashing chained");
+  TestHashTable(HashSetOpenAddressed, 0, "open-addressed");
   return 0;
 }
 
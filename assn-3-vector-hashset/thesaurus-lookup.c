@@ -125,6 +125,7 @@ static void TokenizeAndBuildThesaurus(hashset *thesaurus, streamtokenizer *st)
       char *synonym = strdup(buffer);
       VectorAppend(&entry.synonyms, &synonym);
     }
+    VectorShrinkToFit(&entry.synonyms); // the entry lives as long as the thesaurus
     HashSetEnter(thesaurus, &entry);
     if (HashSetCount(thesaurus) % 1000 == 0) {
       printf(".");
@@ -224,7 +225,8 @@ static const int kApproximateWordCount = (1 << 19) - 1; // six-digit Marsenne pr
 int main(int argc, const char *argv[])
 {
   hashset thesaurus;
-  HashSetNew(&thesaurus, sizeof(thesaurusEntry), kApproximateWordCount, StringHash, StringCompare, ThesEntryFree);
+  HashSetNewWithEngine(&thesaurus, sizeof(thesaurusEntry), kApproximateWordCount, 
+		       StringHash, StringCompare, ThesEntryFree, HashSetOpenAddressed);
   const char *thesaurusFileName = (argc == 1) ? 
     "data/thesaurus.txt" : argv[1];
   ReadThesaurus(&thesaurus, thesaurusFileName);
@@ -5,13 +5,21 @@
 #include <assert.h>
 #include <search.h>
 
-static void VectorGrow(vector *v)
+static void VectorReallocate(vector *v, int allocLength)
 {
-  v->allocLength += v->initialAllocation;
-  v->elems = realloc(v->elems, v->allocLength * v->elemSize);
+  v->allocLength = allocLength;
+  v->elems = realloc(v->elems, (size_t) v->allocLength * v->elemSize);
   assert(v->elems != NULL);
 }
 
+static void VectorGrow(vector *v)
+{
+  int increment = v->initialAllocation;
+  if (v->growthPolicy == VectorGrowGeometric && v->allocLength > increment)
+    increment = v->allocLength;
+  VectorReallocate(v, v->allocLength + increment);
+}
+
 void VectorNew(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAllocation)
 {
   assert(elemSize > 0);
@@ -23,6 +31,7 @@ void VectorNew(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAl
  
   v->allocLength = initialAllocation;
   v->initialAllocation = initialAllocation;
+  v->growthPolicy = VectorGrowGeometric;
   
   v->logLength = 0;
   v->freeFn = freeFn;
@@ -30,6 +39,25 @@ void VectorNew(vector *v, int elemSize, VectorFreeFunction freeFn, int initialAl
   assert(v->elems != NULL);
 }
 
+void VectorSetGrowthPolicy(vector *v, VectorGrowthPolicy policy)
+{
+  v->growthPolicy = policy;
+}
+
+void VectorReserve(vector *v, int capacity)
+{
+  assert(capacity >= 0);
+  if (capacity > v->allocLength)
+    VectorReallocate(v, capacity);
+}
+
+void VectorShrinkToFit(vector *v)
+{
+  int allocLength = v->logLength > 0 ? v->logLength : 1;
+  if (allocLength < v->allocLength)
+    VectorReallocate(v, allocLength);
+}
+
 void VectorDispose(vector *v)
 {
   if (v->freeFn != NULL) {
@@ -56,6 +56,26 @@ typedef void (*VectorMapFunction)(void *elemAddr, void *auxData);
 
 typedef void (*VectorFreeFunction)(void *elemAddr);
 
+/**
+ * Type: VectorGrowthPolicy
+ * ------------------------
+ * Selects how a full vector grows to make room for another element:
+ *
+ *   VectorGrowGeometric: doubles the allocated length (or adds
+ *                        initialAllocation slots, if that's more), so
+ *                        appending n elements copies O(n) bytes in all.
+ *   VectorGrowAdditive:  adds initialAllocation slots each time, as vectors
+ *                        always used to, at the cost of O(n^2 / initialAllocation)
+ *                        bytes copied in all.
+ *
+ * Vectors grow geometrically unless VectorSetGrowthPolicy says otherwise.
+ */
+
+typedef enum {
+  VectorGrowGeometric,
+  VectorGrowAdditive
+} VectorGrowthPolicy;
+
 /**
  * Type: vector
  * ------------
@@ -72,6 +92,7 @@ typedef struct {
   int logLength;
   int elemSize;
   int initialAllocation;
+  VectorGrowthPolicy growthPolicy;
   void *elems;
   VectorFreeFunction freeFn;
 } vector;
@@ -97,23 +118,20 @@ typedef struct {
  * NULL for the ArrayFreeFunction if the elements don't require any special handling.
  *
  * The initialAllocation parameter specifies the initial allocated length 
- * of the vector, as well as the dynamic reallocation increment for those times when the 
- * vector needs to grow.  Rather than growing the vector one element at a time as 
- * elements are added (inefficient), you will grow the vector 
- * in chunks of initialAllocation size.  The allocated length is the number
+ * of the vector, as well as the smallest dynamic reallocation increment for those
+ * times when the vector needs to grow.  Rather than growing the vector one element
+ * at a time as elements are added (inefficient), the vector grows in chunks: by
+ * default it doubles its allocated length (but grows by at least initialAllocation
+ * elements), and a vector switched to VectorGrowAdditive grows by exactly
+ * initialAllocation elements each time.  The allocated length is the number
  * of elements for which space has been allocated: the logical length 
  * is the number of those slots currently being used.
  * 
  * A new vector pre-allocates space for initialAllocation elements, but the
  * logical length is zero.  As elements are added, those allocated slots fill
- * up, and when the initial allocation is all used, grow the vector by another 
- * initialAllocation elements.  You will continue growing the vector in chunks
- * like this as needed.  Thus the allocated length will always be a multiple
- * of initialAllocation.  Don't worry about using realloc to shrink the vector's 
- * allocation if a bunch of elements get deleted.  It turns out that 
- * many implementations of realloc don't even pay attention to such a request, 
- * so there is little point in asking.  Just leave the vector over-allocated and no
- * one will care.
+ * up, and when the allocation is all used, the vector grows as described above.
+ * The vector never shrinks its allocation when elements get deleted; clients who
+ * want the memory back can ask for it with VectorShrinkToFit.
  *
  * The initialAllocation is the client's opportunity to tune the resizing
  * behavior for his/her particular needs.  Clients who expect their vectors to
@@ -128,6 +146,41 @@ typedef struct {
 
 void VectorNew(vector *v, int elemSize, VectorFreeFunction freefn, int initialAllocation);
 
+/**
+ * Function: VectorSetGrowthPolicy
+ * Usage: VectorSetGrowthPolicy(&myFriends, VectorGrowAdditive);
+ * -------------------------------
+ * Selects how the vector grows from now on.  See the VectorGrowthPolicy
+ * type above for the choices.
+ */
+
+void VectorSetGrowthPolicy(vector *v, VectorGrowthPolicy policy);
+
+/**
+ * Function: VectorReserve
+ * Usage: VectorReserve(&lotsOfNumbers, numNumbers);
+ * -----------------------
+ * Makes sure the vector has room for at least capacity elements, so
+ * that appending up to capacity elements in all never reallocates.
+ * Clients who know how large a vector will become can save all of the
+ * intermediate reallocations this way.  The logical length is unchanged,
+ * and the allocation never shrinks.  An assert is raised if capacity is
+ * less than 0.
+ */
+
+void VectorReserve(vector *v, int capacity);
+
+/**
+ * Function: VectorShrinkToFit
+ * Usage: VectorShrinkToFit(&synonyms);
+ * ---------------------------
+ * Gives back the allocated slots not currently in use, reallocating the
+ * vector to hold exactly its logical length (or a single element, if it's
+ * empty).  Pointers returned by VectorNth become invalid.
+ */
+
+void VectorShrinkToFit(vector *v);
+
 /**
  * Function: VectorDispose
  *           VectorDispose(&studentsDroppingTheCourse);
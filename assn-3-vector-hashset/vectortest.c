@@ -173,6 +173,31 @@ static void TestReplace(vector *alphabet)
   VectorMap(alphabet, PrintChar, stdout);
 }
 
+/**
+ * Function: TestReserveAndShrink
+ * ------------------------------
+ * Reserves far more room than the vector needs and then shrinks it
+ * back down, confirming that neither changes the contents, and that
+ * appending into reserved room and after shrinking both work.
+ */
+
+static void TestReserveAndShrink(vector *alphabet)
+{
+  int length = VectorLength(alphabet);
+  char ch = '+';
+
+  VectorReserve(alphabet, 1000);
+  assert(VectorLength(alphabet) == length);
+  VectorAppend(alphabet, &ch);
+  VectorShrinkToFit(alphabet);
+  assert(VectorLength(alphabet) == length + 1);
+  VectorAppend(alphabet, &ch);
+  VectorDelete(alphabet, VectorLength(alphabet) - 1);
+  VectorDelete(alphabet, VectorLength(alphabet) - 1);
+  fprintf(stdout, "\nAfter reserving, shrinking and appending: ");
+  VectorMap(alphabet, PrintChar, stdout);
+}
+
 /** 
  * Function: SimpleTest
  * --------------------
@@ -198,6 +223,7 @@ static void SimpleTest()
   TestAt(&alphabet);
   TestInsertDelete(&alphabet);
   TestReplace(&alphabet);
+  TestReserveAndShrink(&alphabet);
   VectorDispose(&alphabet);
 }
 
@@ -31,19 +31,20 @@ void InitializePrevSeenArticles(hashset *prevSeenArticles)
     articleCompareFn, articleFreeFn);
 }
 
+static void articleInitFn(void *elemAddr)
+{
+  article *a = (article *) elemAddr;
+  a->url = strdup(a->url);
+  a->title = strdup(a->title);
+}
+
 bool IsNewArticle(hashset *prevSeenArticles, char *url, char *title)
 {
   article a;
   a.url = url;
   a.title = title;
 
-  void *prevSeen = HashSetLookup(prevSeenArticles, &a);
-  if (prevSeen != NULL) {
-    return false;
-  } else {
-    a.url = strdup(url);
-    a.title = strdup(title);
-    HashSetEnter(prevSeenArticles, &a);
-    return true;
-  }
+  bool isNew;
+  HashSetFindOrInsert(prevSeenArticles, &a, articleInitFn, &isNew);
+  return isNew;
 } 
@@ -62,6 +62,18 @@ typedef void (*HashSetMapFunction)(void *elemAddr, void *auxData);
 
 typedef void (*HashSetFreeFunction)(void *elemAddr);
 
+/**
+ * Type: HashSetInitFunction
+ * -------------------------
+ * Class of functions designed to finish initializing an element
+ * that HashSetFindOrInsert has just copied into a hashset from
+ * a key, typically by replacing borrowed pointers with copies the
+ * hashset can own and by setting up the fields the key left out.
+ * It mustn't change anything the hash or compare functions look at.
+ */
+
+typedef void (*HashSetInitFunction)(void *elemAddr);
+
 /**
  * Type: hashset
  * -------------
@@ -184,6 +196,24 @@ void HashSetEnter(hashset *h, const void *elemAddr);
 
 void *HashSetLookup(hashset *h, const void *elemAddr);
 
+/**
+ * Function: HashSetFindOrInsert
+ * -----------------------------
+ * Returns the address of the element matching the key, inserting a
+ * copy of the key first if there isn't one, in which case initFn (if
+ * it isn't NULL) is called on the copy before it's returned.  The key
+ * is hashed and searched for once, where looking it up, entering it
+ * and looking it up again would do both twice.  If inserted isn't NULL,
+ * *inserted is set to true if and only if the key was inserted.  The
+ * key has to be a full element, although only the fields the hash and
+ * compare functions use need be set, since initFn can fill in the rest.
+ * The address is only good until the next insertion.
+ *
+ * An assert is raised under the same conditions as for HashSetEnter.
+ */
+
+void *HashSetFindOrInsert(hashset *h, const void *key, HashSetInitFunction initFn, bool *inserted);
+
 /**
  * Function: HashSetMap
  * --------------------
@@ -27,6 +27,13 @@ void InitializeWordCounts(hashset *wordCount)
   HashSetNew(wordCount, sizeof(wordSet), 10007, wordHashFn, wordCmpFn, wordSetFreeFn);
 }
 
+static void wordSetInitFn(void *elemAddr)
+{
+  wordSet *ws = (wordSet *) elemAddr;
+  ws->word = strdup(ws->word);
+  VectorNew(&ws->occ, sizeof(articleCount), articleCountFreeFn, 25);
+}
+
 int articleCountCompareFn(const void *elemAddr1, const void *elemAddr2)
 {
   articleCount *ac1 = (articleCount *) elemAddr1;
@@ -44,19 +51,9 @@ void WordCountEnter(hashset *wordCount, const char *word, const char *articleTit
    * 3. Word/article combination has been entered
    */
 
-  wordSet *existingWord = (wordSet *) HashSetLookup(wordCount, &word);
- 
-  // ensure that the word exists in the hashset 
-  if (existingWord == NULL) {
-    wordSet ws;
-    ws.word = strdup(word);
-    VectorNew(&ws.occ, sizeof(articleCount), articleCountFreeFn, 25); 
-    HashSetEnter(wordCount, &ws); 
-  }
-
-  // an entry for the word should always exist now
-  existingWord = (wordSet *) HashSetLookup(wordCount, &word);
-  assert(existingWord != NULL); 
+  // find the word's entry, creating it if the word is new
+  wordSet key = { (char *) word };
+  wordSet *existingWord = (wordSet *) HashSetFindOrInsert(wordCount, &key, wordSetInitFn, NULL);
 
   // now either add the article to the word count vector or increment its current count
   articleCount articleKey = { { (char *) articleTitle, (char *) articleURL }, 1 };
@@ -0,0 +1,28 @@
+#include "hashset.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * The rest of the hashset comes precompiled in librssnews, so this
+ * works on its representation directly, the same way HashSetEnter
+ * and HashSetLookup do: the key's bucket is searched linearly, and
+ * a new element is appended to it.
+ */
+
+void *HashSetFindOrInsert(hashset *h, const void *key, HashSetInitFunction initFn, bool *inserted)
+{
+  assert(key != NULL);
+  int bucket = h->hashfn(key, h->numBuckets);
+  assert(bucket >= 0 && bucket < h->numBuckets);
+
+  vector *v = h->buckets + bucket;
+  int position = VectorSearch(v, key, h->comparefn, 0, false);
+  if (inserted != NULL) *inserted = position == -1;
+  if (position != -1) return VectorNth(v, position);
+
+  VectorAppend(v, key);
+  h->elemCount++;
+  void *elemAddr = VectorNth(v, VectorLength(v) - 1);
+  if (initFn != NULL) initFn(elemAddr);
+  return elemAddr;
+}
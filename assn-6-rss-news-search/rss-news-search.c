@@ -103,6 +103,7 @@ static void NewsArticleFree(void *elem);
 static int IndexEntryHash(const void *elem, int numBuckets);
 static int IndexEntryCompare(const void *elem1, const void *elem2);
 static void IndexEntryFree(void *elem);
+static void IndexEntryInit(void *elem);
 
 static int ArticleIndexCompare(const void *elem1, const void *elem2);
 static int ArticleFrequencyCompare(const void *elem1, const void *elem2);
@@ -231,6 +232,19 @@ void ServerLimitsFree(void *elemAddr)
   sem_destroy(&entry->connections);
 }
 
+/**
+ * ServerLimitsInit
+ * ----------------
+ *  Gives a newly entered server its own copy of its name and a semaphore
+ *  allowing it eight simultaneous connections.
+ */
+static void ServerLimitsInit(void *elemAddr)
+{
+  serverEntry *entry = elemAddr;
+  entry->server = strdup(entry->server);
+  sem_init(&entry->connections, 0, 8);
+}
+
 /**
  * Function: BuildIndices
  * ----------------------
@@ -298,17 +312,10 @@ static void BuildIndices(rssDatabase *db, const char *feedsFileName)
  */
 void ServerWait(hashset *serverLimits, sem_t *serverLimitsLock, const char *serverName) 
 {
+  serverEntry key = { (char *) serverName };
   sem_wait(serverLimitsLock);
-  serverEntry *entry = HashSetLookup(serverLimits, &serverName);
-  // assure that the server exists in the hashset
-  if (entry == NULL) {
-    serverEntry newEntry;
-    newEntry.server = strdup(serverName);
-    HashSetEnter(serverLimits, &newEntry);
-    entry = HashSetLookup(serverLimits, &serverName);
-    assert(entry != NULL);
-    sem_init(&entry->connections, 0, 8);
-  }
+  // find the server's entry, adding it if this is its first connection
+  serverEntry *entry = HashSetFindOrInsert(serverLimits, &key, ServerLimitsInit, NULL);
   sem_post(serverLimitsLock);
   sem_wait(&entry->connections);
 }
@@ -725,14 +732,7 @@ static void AddWordToIndices(hashset *indices, const char *word, int articleInde
   rssIndexEntry indexEntry = { word }; // partial intialization
 
   sem_wait(indicesLock);
-  rssIndexEntry *existingIndexEntry = HashSetLookup(indices, &indexEntry);
-  if (existingIndexEntry == NULL) {
-    indexEntry.meaningfulWord = strdup(word);
-    VectorNew(&indexEntry.relevantArticles, sizeof(rssRelevantArticleEntry), NULL, 0);
-    HashSetEnter(indices, &indexEntry);
-    existingIndexEntry = HashSetLookup(indices, &indexEntry); // pretend like it's been there all along
-    assert(existingIndexEntry != NULL);
-  }
+  rssIndexEntry *existingIndexEntry = HashSetFindOrInsert(indices, &indexEntry, IndexEntryInit, NULL);
 
   rssRelevantArticleEntry articleEntry = { articleIndex, 0 };
   int existingArticleIndex =
@@ -1090,6 +1090,21 @@ static void IndexEntryFree(void *elem)
   VectorDispose(&entry->relevantArticles);
 }
 
+/**
+ * Function: IndexEntryInit
+ * ------------------------
+ * Finishes the rssIndexEntry HashSetFindOrInsert has just entered
+ * on behalf of AddWordToIndices: the entry takes its own copy of
+ * the word, and starts out with no relevant articles.
+ */
+
+static void IndexEntryInit(void *elem)
+{
+  rssIndexEntry *entry = elem;
+  entry->meaningfulWord = strdup(entry->meaningfulWord);
+  VectorNew(&entry->relevantArticles, sizeof(rssRelevantArticleEntry), NULL, 0);
+}
+
 static int ArticleIndexCompare(const void *elem1, const void *elem2)
 {
   const rssRelevantArticleEntry *entry1 = elem1;